@@ -1,18 +1,44 @@
 #include <am.h>
+#include <nemu.h>
 #include <stdatomic.h>
 #include <klib-macros.h>
 
-bool mpe_init(void (*entry)()) {
-  entry();
+#define MPE_NR_CPU   (MPE_ADDR + 0x00)
+#define MPE_CPU_ID   (MPE_ADDR + 0x04)
+#define MPE_CPU_SEL  (MPE_ADDR + 0x08)
+#define MPE_START_SP (MPE_ADDR + 0x0c)
+#define MPE_START_PC (MPE_ADDR + 0x10)
+
+#define MAX_CPU 8
+#define MPE_STACK_SIZE (8 * PGSIZE)
+
+// the boot CPU keeps using the stack set up by _start
+static uint8_t mpe_stack[MAX_CPU - 1][MPE_STACK_SIZE] __attribute__((aligned(PGSIZE)));
+static void (*mpe_entry)() = NULL;
+
+static void mpe_start() {
+  mpe_entry();
   panic("MPE entry returns");
 }
 
+bool mpe_init(void (*entry)()) {
+  mpe_entry = entry;
+  for (int i = 1; i < cpu_count(); i ++) {
+    outl(MPE_CPU_SEL, i);
+    outl(MPE_START_SP, (uintptr_t)mpe_stack[i - 1] + MPE_STACK_SIZE);
+    outl(MPE_START_PC, (uintptr_t)mpe_start);
+  }
+  mpe_start();
+  return false;
+}
+
 int cpu_count() {
-  return 1;
+  int n = inl(MPE_NR_CPU);
+  return (n > MAX_CPU ? MAX_CPU : n);
 }
 
 int cpu_current() {
-  return 0;
+  return inl(MPE_CPU_ID);
 }
 
 int atomic_xchg(int *addr, int newval) {
@@ -0,0 +1,46 @@
+/***************************************************************************************
+* Copyright (c) 2014-2024 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#ifndef __CPU_BPRED_H__
+#define __CPU_BPRED_H__
+
+#include <common.h>
+
+/* Branch predictor models. The ISA reports every control transfer of the
+ * guest, which is predicted by the selected direction predictor, a BTB
+ * and a return address stack. The outcome never changes the execution of
+ * the guest, only the misprediction statistics reported when NEMU stops.
+ * The model is selected by --bpred or the `bpred' command of sdb.
+ */
+enum { BP_OFF, BP_BIMODAL, BP_GSHARE, BP_TAGE, NR_BP_MODEL };
+
+// kinds of control transfer
+enum { BP_COND, BP_CALL, BP_RET, BP_JUMP, NR_BP_KIND };
+
+extern int bpred_model;
+
+void bpred_update(vaddr_t pc, int kind, bool taken, vaddr_t target, vaddr_t ret_addr);
+bool bpred_select(const char *name);
+void bpred_report();
+
+static inline void bpred_cond(vaddr_t pc, bool taken, vaddr_t target) {
+  if (unlikely(bpred_model != BP_OFF)) bpred_update(pc, BP_COND, taken, target, 0);
+}
+
+static inline void bpred_jump(vaddr_t pc, int kind, vaddr_t target, vaddr_t ret_addr) {
+  if (unlikely(bpred_model != BP_OFF)) bpred_update(pc, kind, true, target, ret_addr);
+}
+
+#endif
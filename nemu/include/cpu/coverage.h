@@ -0,0 +1,56 @@
+/***************************************************************************************
+* Copyright (c) 2014-2024 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#ifndef __CPU_COVERAGE_H__
+#define __CPU_COVERAGE_H__
+
+#include <common.h>
+
+/* Code coverage of the guest. One bit for each instruction slot in the
+ * physical memory is set when an instruction there is executed, and two
+ * more bits record whether a conditional branch there is taken or not.
+ * The bitmaps are written to the file given by --coverage, and ORed with
+ * the bitmaps already in that file, so several runs accumulate.
+ *
+ * file:  "NEMUCOV1", uint32_t slot shift, uint32_t reserved,
+ *        uint64_t base address, uint64_t number of slots,
+ *        then the executed, taken and not taken bitmaps, each of which
+ *        has (number of slots + 7) / 8 bytes
+ * Use tools/nemu-cov to merge the files and convert them to lcov.
+ */
+#define COV_SLOT_SHIFT 2
+#define COV_NR_SLOT (CONFIG_MSIZE >> COV_SLOT_SHIFT)
+enum { COV_EXEC, COV_TAKEN, COV_NOT_TAKEN, NR_COV_MAP };
+
+// NULL if coverage is disabled
+extern uint8_t *cov_map[NR_COV_MAP];
+
+static inline void cov_set(int map, vaddr_t pc) {
+  word_t idx = (pc - CONFIG_MBASE) >> COV_SLOT_SHIFT;
+  if (idx < COV_NR_SLOT) cov_map[map][idx >> 3] |= 1u << (idx & 7);
+}
+
+static inline void cov_exec(vaddr_t pc) {
+  if (cov_map[COV_EXEC] != NULL) cov_set(COV_EXEC, pc);
+}
+
+static inline void cov_branch(vaddr_t pc, bool taken) {
+  if (cov_map[COV_EXEC] != NULL) cov_set(taken ? COV_TAKEN : COV_NOT_TAKEN, pc);
+}
+
+void init_coverage(const char *file);
+void coverage_dump();
+
+#endif
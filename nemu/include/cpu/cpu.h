@@ -20,6 +20,28 @@
 
 void cpu_exec(uint64_t n);
 
+// interrupt lines driven by devices
+enum { INTR_LINE_TIMER };
+void cpu_raise_intr(int line);
+uint32_t cpu_fetch_intr();
+
+// events counted for the hardware performance monitor
+enum { HPM_EV_LOAD, HPM_EV_STORE, HPM_EV_BRANCH, HPM_EV_MMIO, NR_HPM_EV };
+#ifdef CONFIG_HPM
+extern MUXDEF(CONFIG_SMP_THREAD, __thread, ) uint64_t hpm_block_event[NR_HPM_EV];
+#define hpm_count(ev) (hpm_block_event[ev] ++)
+#else
+#define hpm_count(ev)
+#endif
+// counts of the current hart
+uint64_t cpu_instret();
+uint64_t cpu_hpm_event(int ev);
+
+#ifdef CONFIG_SMP
+int hart_id();
+void hart_start(int id, vaddr_t pc, word_t sp);
+#endif
+
 void set_nemu_state(int state, vaddr_t pc, int halt_ret);
 void invalid_inst(vaddr_t thispc);
 
@@ -0,0 +1,57 @@
+/***************************************************************************************
+* Copyright (c) 2014-2024 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#ifndef __CPU_FTRACE_H__
+#define __CPU_FTRACE_H__
+
+#include <common.h>
+
+// function symbols of the guest ELF given by --elf
+typedef struct {
+  vaddr_t start, end;
+  char *name;
+} ElfSym;
+
+void init_elf(const char *file);
+const ElfSym *elf_lookup(vaddr_t addr);
+int elf_nr_sym();
+const ElfSym *elf_sym(int idx);
+
+/* Function call tracer. Calls and returns detected by the ISA maintain a
+ * shadow call stack of the guest, and are written to the file given by
+ * --ftrace in the binary trace container (see cpu/itrace.h):
+ *   magic:   "NEMUFTR1"
+ *   symbols: uint32_t nr, then for each: uint64_t start, uint64_t end,
+ *            uint32_t name length, name (without '\0')
+ *   record:  uint8_t kind (0: call, 1: return), varint zigzag(pc - previous pc),
+ *            varint zigzag(target - pc), varint (instruction count - previous one)
+ */
+enum { FTRACE_CALL, FTRACE_RET };
+
+typedef struct {
+  vaddr_t func;     // entry of the callee
+  vaddr_t ret_addr; // where the callee returns to
+} FtraceFrame;
+
+#define FTRACE_MAX_DEPTH 1024
+extern FtraceFrame ftrace_stack[FTRACE_MAX_DEPTH];
+extern int ftrace_depth;
+
+void init_ftrace(const char *file);
+void ftrace_call(vaddr_t pc, vaddr_t target, vaddr_t ret_addr);
+void ftrace_ret(vaddr_t pc, vaddr_t target);
+void ftrace_close();
+
+#endif
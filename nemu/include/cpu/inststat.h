@@ -0,0 +1,54 @@
+/***************************************************************************************
+* Copyright (c) 2014-2024 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#ifndef __CPU_INSTSTAT_H__
+#define __CPU_INSTSTAT_H__
+
+#include <common.h>
+
+/* Exact execution counts of each pc in the physical memory, and of each
+ * instruction pattern. Counting is enabled by --inst-stat, and the counts
+ * are reported by statistic().
+ */
+#define INST_STAT_NR_PC (CONFIG_MSIZE >> 2)
+
+// NULL if counting is disabled
+extern uint64_t *inst_stat_pc_cnt;
+
+static inline void inst_stat_pc(vaddr_t pc) {
+  if (inst_stat_pc_cnt == NULL) return;
+  word_t idx = (pc - CONFIG_MBASE) >> 2;
+  if (idx < INST_STAT_NR_PC) inst_stat_pc_cnt[idx] ++;
+}
+
+typedef struct InstPatCount {
+  const char *name;
+  uint64_t count;
+  struct InstPatCount *next;
+} InstPatCount;
+
+void inst_stat_register(InstPatCount *c);
+
+// count the instruction pattern named `pat' in its INSTPAT_MATCH()
+#define inst_stat_pattern(pat) do { \
+  static InstPatCount __inst_pat_count = { .name = pat }; \
+  if (inst_stat_pc_cnt != NULL && __inst_pat_count.count ++ == 0) \
+    inst_stat_register(&__inst_pat_count); \
+} while (0)
+
+void init_inst_stat(const char *file);
+void inst_stat_report();
+
+#endif
@@ -0,0 +1,118 @@
+/***************************************************************************************
+* Copyright (c) 2014-2024 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#ifndef __CPU_ITRACE_H__
+#define __CPU_ITRACE_H__
+
+#include <cpu/decode.h>
+
+/* Binary trace files share one container format (little endian):
+ *   header: 8-byte magic, uint32_t word size in bytes, uint32_t reserved
+ *   blocks: uint32_t nr_rec, uint32_t raw_len, uint32_t comp_len,
+ *           followed by comp_len bytes of zlib stream
+ * Deltas inside records restart from 0 in each block, so blocks can be
+ * decoded alone.
+ */
+typedef struct TraceFile TraceFile;
+TraceFile *trace_file_open(const char *file, const char *magic, size_t max_raw_len);
+void trace_file_write_raw(TraceFile *tf, const void *buf, size_t len);
+void trace_file_write_u32(TraceFile *tf, uint32_t v);
+void trace_file_write_block(TraceFile *tf, const void *raw, uint32_t raw_len, uint32_t nr_rec);
+void trace_file_flush(TraceFile *tf);
+
+static inline uint8_t *put_varint(uint8_t *p, uint64_t v) {
+  while (v >= 0x80) {
+    *p ++ = v | 0x80;
+    v >>= 7;
+  }
+  *p ++ = v;
+  return p;
+}
+
+static inline uint64_t zigzag(int64_t v) {
+  return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+/* Binary instruction trace. The exec loop only fills fixed-size records,
+ * which are encoded and compressed a block at a time. The file is read by
+ * tools/nemu-trace.
+ *
+ * magic: "NEMUITR1"
+ * record: uint8_t flags, varint zigzag(pc - pc of previous record),
+ *         uint32_t inst, [varint rd value], [varint zigzag(maddr - previous maddr)]
+ */
+
+#define ITRACE_REC_RD  0x1 // the record carries the value written to rd
+#define ITRACE_REC_MEM 0x2 // the record carries the address of a data access
+#define ITRACE_BLOCK_NR_REC 4096
+
+typedef struct {
+  vaddr_t pc;
+  uint32_t inst;
+  uint8_t flags;
+  word_t rd_val;
+  vaddr_t maddr;
+} ItraceRec;
+
+extern ItraceRec *itrace_buf;
+extern int itrace_nr;
+extern vaddr_t itrace_maddr;
+extern bool itrace_has_maddr;
+
+void init_itrace(const char *file);
+void itrace_flush_block();
+void itrace_close();
+
+// record the address of a data access by the current instruction
+#define itrace_mem(addr) IFDEF(CONFIG_ITRACE_BIN, (itrace_maddr = (addr), itrace_has_maddr = true))
+
+#ifdef CONFIG_ITRACE_BIN
+static inline void itrace_write(Decode *s) {
+  if (itrace_buf == NULL) return;
+  ItraceRec *r = &itrace_buf[itrace_nr];
+  r->pc = s->pc;
+  r->inst = s->isa.inst;
+  r->flags = (itrace_has_maddr ? ITRACE_REC_MEM : 0);
+  r->maddr = itrace_maddr;
+  itrace_has_maddr = false;
+  IFDEF(CONFIG_ITRACE_BIN_RD, if (isa_itrace_rd(s, &r->rd_val)) r->flags |= ITRACE_REC_RD);
+  if (++ itrace_nr == ITRACE_BLOCK_NR_REC) itrace_flush_block();
+}
+#endif
+
+#ifdef CONFIG_IQUEUE
+/* Raw (pc, inst) of the recently executed instructions, which are only
+ * disassembled when they are dumped on failure.
+ */
+typedef struct {
+  vaddr_t pc;
+  uint32_t inst;
+} IqueueRec;
+
+static_assert((CONFIG_IQUEUE_SIZE & (CONFIG_IQUEUE_SIZE - 1)) == 0,
+    "IQUEUE_SIZE should be a power of 2");
+extern MUXDEF(CONFIG_SMP_THREAD, __thread, ) IqueueRec iqueue[CONFIG_IQUEUE_SIZE];
+extern MUXDEF(CONFIG_SMP_THREAD, __thread, ) uint64_t iqueue_nr;
+
+static inline void iqueue_push(Decode *s) {
+  IqueueRec *r = &iqueue[iqueue_nr ++ & (CONFIG_IQUEUE_SIZE - 1)];
+  r->pc = s->pc;
+  r->inst = s->isa.inst;
+}
+#endif
+
+void iqueue_dump();
+
+#endif
@@ -0,0 +1,62 @@
+/***************************************************************************************
+* Copyright (c) 2014-2024 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#ifndef __CPU_PIPELINE_H__
+#define __CPU_PIPELINE_H__
+
+#include <common.h>
+
+/* Asynchronous analysis pipeline. The exec loop and the memory accessors
+ * append compact event records to a local batch. A full batch is copied
+ * into the lock-free ring of every consumer, and each consumer processes
+ * its ring on its own host thread. When a ring is full, the batch is
+ * either dropped for that consumer or the guest waits, as the consumer
+ * chooses.
+ */
+enum { PIPE_INST, PIPE_LOAD, PIPE_STORE, PIPE_BRANCH };
+
+typedef struct {
+  uint8_t kind;
+  uint8_t len;   // size of a memory access
+  uint8_t taken; // outcome of a branch
+  vaddr_t pc;
+  vaddr_t addr;  // address of a memory access, or target of a taken branch
+} PipeEvent;
+
+typedef void (*pipe_consumer_t)(void *arg, const PipeEvent *ev, int nr);
+
+#ifdef CONFIG_PIPELINE
+#define PIPE_BATCH 256
+
+extern bool pipeline_on;
+extern PipeEvent pipe_batch[PIPE_BATCH];
+extern int pipe_nr;
+
+void pipeline_add_consumer(const char *name, pipe_consumer_t fn, void *arg, bool drop);
+void pipeline_publish();
+void pipeline_close();
+
+static inline void pipe_event(int kind, vaddr_t pc, vaddr_t addr, int len, bool taken) {
+  pipe_batch[pipe_nr ++] = (PipeEvent) { .kind = kind, .len = len, .taken = taken, .pc = pc, .addr = addr };
+  if (pipe_nr == PIPE_BATCH) pipeline_publish();
+}
+
+#define pipe_put(kind, pc, addr, len, taken) \
+  do { if (unlikely(pipeline_on)) pipe_event(kind, pc, addr, len, taken); } while (0)
+#else
+#define pipe_put(kind, pc, addr, len, taken)
+#endif
+
+#endif
@@ -0,0 +1,43 @@
+/***************************************************************************************
+* Copyright (c) 2014-2024 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#ifndef __CPU_PLUGIN_H__
+#define __CPU_PLUGIN_H__
+
+#include <common.h>
+
+/* Whether any loaded plugin subscribes to each kind of event. The exec loop
+ * selects a variant with the instruction callback only when it is needed,
+ * and the other sites only test their flag.
+ */
+enum { PLUGIN_EV_BLOCK, PLUGIN_EV_INST, PLUGIN_EV_MEM, PLUGIN_EV_MMIO, PLUGIN_EV_TRAP, NR_PLUGIN_EV };
+
+#ifdef CONFIG_PLUGIN
+extern bool plugin_on[NR_PLUGIN_EV];
+
+void plugin_block_exec(vaddr_t pc, uint64_t nr_inst);
+void plugin_inst_exec(vaddr_t pc, uint32_t inst);
+void plugin_mem_access(vaddr_t addr, int len, bool is_write, word_t data);
+void plugin_mmio_access(const char *dev, paddr_t addr, int len, bool is_write, word_t data);
+void plugin_trap(vaddr_t epc, word_t cause);
+
+#define plugin_event(ev, call) do { if (unlikely(plugin_on[ev])) call; } while (0)
+#else
+#define plugin_event(ev, call)
+#endif
+
+void load_plugin(const char *spec);
+
+#endif
@@ -0,0 +1,37 @@
+/***************************************************************************************
+* Copyright (c) 2014-2024 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#ifndef __CPU_PROFILE_H__
+#define __CPU_PROFILE_H__
+
+#include <common.h>
+
+/* Sampling profiler. Every CONFIG_PROFILE_INTERVAL instructions, the pc and
+ * the shadow call stack kept by the function call tracer are recorded at a
+ * block boundary. Identical stacks are counted in a hash table, and written
+ * as collapsed stacks ("main;f;g 42") to the file given by --profile, which
+ * can be fed to flamegraph.pl or speedscope.
+ */
+extern uint64_t profile_next; // instruction count of the next sample
+
+void init_profile(const char *file);
+void profile_sample();
+void profile_dump();
+
+static inline void profile_check(uint64_t nr_inst) {
+  if (nr_inst >= profile_next) profile_sample();
+}
+
+#endif
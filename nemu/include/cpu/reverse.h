@@ -0,0 +1,66 @@
+/***************************************************************************************
+* Copyright (c) 2014-2024 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#ifndef __CPU_REVERSE_H__
+#define __CPU_REVERSE_H__
+
+#include <common.h>
+#include <memory/vaddr.h>
+
+/* Reverse execution. Every CONFIG_REVERSE_INTERVAL instructions, a
+ * checkpoint of `cpu' is taken at a block boundary, and the old contents
+ * of the pmem pages first written after it are saved into it. Going back
+ * restores the nearest checkpoint before the target and replays the
+ * instructions up to it. MMIO reads, counter reads and the interrupts
+ * taken are recorded in the live run and fed back in the replay, so the
+ * replay is deterministic.
+ */
+enum { REV_LIVE, REV_REPLAY, REV_SEARCH }; // breakpoints only stop REV_SEARCH replays
+extern int rev_mode;
+#define rev_live() MUXDEF(CONFIG_REVERSE, rev_mode == REV_LIVE, true)
+
+#define REV_NR_PAGE (CONFIG_MSIZE >> PAGE_SHIFT)
+extern uint8_t rev_page_saved[REV_NR_PAGE / 8]; // pages saved since the newest checkpoint
+extern uint64_t rev_next; // instruction count of the next checkpoint
+
+void rev_take_ckpt(uint64_t nr_inst);
+void rev_save_page(paddr_t pg);
+void cpu_set_inst_count(uint64_t n);
+uint64_t rev_record(uint64_t val);
+uint64_t rev_replay();
+word_t rev_query_intr();
+uint32_t rev_intr_lines(uint32_t lines);
+bool rev_step(uint64_t n);
+bool rev_continue();
+
+static inline void rev_check(uint64_t nr_inst) {
+  if (nr_inst >= rev_next) rev_take_ckpt(nr_inst);
+}
+
+// called before pmem is written
+static inline void rev_write(paddr_t addr, int len) {
+  paddr_t pg = (addr - CONFIG_MBASE) >> PAGE_SHIFT;
+  paddr_t pg_end = (addr + len - 1 - CONFIG_MBASE) >> PAGE_SHIFT;
+  if (unlikely(!((rev_page_saved[pg >> 3] >> (pg & 7)) & 1))) rev_save_page(pg);
+  if (unlikely(pg_end != pg && pg_end < REV_NR_PAGE &&
+        !((rev_page_saved[pg_end >> 3] >> (pg_end & 7)) & 1))) rev_save_page(pg_end);
+}
+
+// a value from outside of the guest, e.g. read from a device
+static inline uint64_t rev_input(uint64_t val) {
+  return (rev_mode == REV_LIVE ? rev_record(val) : rev_replay());
+}
+
+#endif
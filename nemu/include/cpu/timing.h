@@ -0,0 +1,33 @@
+/***************************************************************************************
+* Copyright (c) 2014-2024 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#ifndef __CPU_TIMING_H__
+#define __CPU_TIMING_H__
+
+#include <common.h>
+
+/* Timing model of an in-order core. The ISA charges each executed
+ * instruction the latency of its class, and the cache and branch
+ * predictor models add their penalties to the stall of the current
+ * instruction. The cycle count is read through mcycle.
+ */
+extern uint64_t timing_stall;
+
+#define timing_add_stall(n) IFDEF(CONFIG_TIMING, timing_stall += (n))
+
+uint64_t timing_cycles();
+void timing_report();
+
+#endif
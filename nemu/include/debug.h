@@ -20,20 +20,32 @@
 #include <stdio.h>
 #include <utils.h>
 
+/* Messages above CONFIG_LOG_LEVEL are compiled out. The others cost one
+ * branch on a global when they are disabled at runtime.
+ */
+#define _LogAt(level, cond, color, format, ...) \
+  do { \
+    if ((level) <= CONFIG_LOG_LEVEL && (cond)) \
+      _Log(ANSI_FMT("[%s:%d %s] " format, color) "\n", \
+          __FILE__, __LINE__, __func__, ## __VA_ARGS__); \
+  } while (0)
+
 #define Log(format, ...) \
-    _Log(ANSI_FMT("[%s:%d %s] " format, ANSI_FG_BLUE) "\n", \
-        __FILE__, __LINE__, __func__, ## __VA_ARGS__)
+    _LogAt(LOG_LV_INFO, log_level >= LOG_LV_INFO, ANSI_FG_BLUE, format, ## __VA_ARGS__)
 
 #define Warn(format, ...) \
-    _Log(ANSI_FMT("[%s:%d %s] " format, ANSI_FG_YELLOW) "\n", \
-        __FILE__, __LINE__, __func__, ## __VA_ARGS__)
+    _LogAt(LOG_LV_WARN, log_level >= LOG_LV_WARN, ANSI_FG_YELLOW, format, ## __VA_ARGS__)
+
+// `mod' is one of LOG_ISA, LOG_CPU, ...
+#define Debug(mod, format, ...) \
+    _LogAt(LOG_LV_DEBUG, log_debug_mods & (1u << (mod)), ANSI_FG_CYAN, format, ## __VA_ARGS__)
 
 #define Assert(cond, format, ...) \
   do { \
     if (!(cond)) { \
       MUXDEF(CONFIG_TARGET_AM, printf(ANSI_FMT(format, ANSI_FG_RED) "\n", ## __VA_ARGS__), \
         (fflush(stdout), fprintf(stderr, ANSI_FMT(format, ANSI_FG_RED) "\n", ##  __VA_ARGS__))); \
-      IFNDEF(CONFIG_TARGET_AM, extern FILE* log_fp; fflush(log_fp)); \
+      IFNDEF(CONFIG_TARGET_AM, log_flush()); \
       extern void assert_fail_msg(); \
       assert_fail_msg(); \
       assert(cond); \
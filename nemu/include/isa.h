@@ -29,13 +29,18 @@ extern unsigned char isa_logo[];
 void init_isa();
 
 // reg
-extern CPU_state cpu;
+// with host threads, each hart has its own `cpu' on the thread running it
+extern MUXDEF(CONFIG_SMP_THREAD, __thread, ) CPU_state cpu;
 void isa_reg_display();
 word_t isa_reg_str2val(const char *name, bool *success);
+// the address of the register in `cpu', or NULL if there is no such register
+word_t *isa_reg_ptr(const char *name);
 
 // exec
 struct Decode;
 int isa_exec_once(struct Decode *s);
+// the value written to the destination register, if `s' writes one
+bool isa_itrace_rd(struct Decode *s, word_t *val);
 
 // memory
 enum { MMU_DIRECT, MMU_TRANSLATE, MMU_FAIL };
@@ -51,6 +56,9 @@ vaddr_t isa_raise_intr(word_t NO, vaddr_t epc);
 #define INTR_EMPTY ((word_t)-1)
 word_t isa_query_intr();
 
+// smp
+void isa_hart_init(CPU_state *hart, int id, vaddr_t pc, word_t sp);
+
 // difftest
 bool isa_difftest_checkregs(CPU_state *ref_r, vaddr_t pc);
 void isa_difftest_attach();
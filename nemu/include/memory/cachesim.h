@@ -0,0 +1,44 @@
+/***************************************************************************************
+* Copyright (c) 2014-2024 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#ifndef __MEMORY_CACHESIM_H__
+#define __MEMORY_CACHESIM_H__
+
+#include <common.h>
+#include <memory/paddr.h>
+
+/* Cache model fed by the accesses of the guest. It only counts hits,
+ * misses and writebacks, and never changes the data seen by the guest.
+ * L1I and L1D are backed by a unified L2.
+ */
+enum { CACHE_L1I, CACHE_L1D, CACHE_L2, NR_CACHE };
+// the type of an access, AMOs are passed as CACHE_RW
+enum { CACHE_R = 1, CACHE_W = 2, CACHE_RW = 3 };
+
+void init_cachesim();
+void cachesim_access(int level, vaddr_t addr, int type, vaddr_t pc);
+void cachesim_report();
+
+#ifdef CONFIG_CACHESIM
+#define cachesim_ifetch(addr) cachesim_access(CACHE_L1I, addr, CACHE_R, addr)
+// MMIO is uncached, so device polling does not distort the counts
+#define cachesim_data(addr, type) \
+  do { if (in_pmem(addr)) cachesim_access(CACHE_L1D, addr, type, cpu.pc); } while (0)
+#else
+#define cachesim_ifetch(addr)
+#define cachesim_data(addr, type)
+#endif
+
+#endif
@@ -31,7 +31,13 @@ static inline bool in_pmem(paddr_t addr) {
   return addr - CONFIG_MBASE < CONFIG_MSIZE;
 }
 
+word_t paddr_ifetch(paddr_t addr, int len);
 word_t paddr_read(paddr_t addr, int len);
 void paddr_write(paddr_t addr, int len, word_t data);
 
+// atomic memory operations, only available for pmem
+enum { AMO_SWAP, AMO_ADD, AMO_XOR, AMO_AND, AMO_OR, AMO_MIN, AMO_MAX, AMO_MINU, AMO_MAXU };
+word_t paddr_amo(paddr_t addr, int len, int op, word_t data);
+bool paddr_cas(paddr_t addr, int len, word_t expected, word_t data);
+
 #endif
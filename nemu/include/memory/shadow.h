@@ -0,0 +1,59 @@
+/***************************************************************************************
+* Copyright (c) 2014-2024 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#ifndef __MEMORY_SHADOW_H__
+#define __MEMORY_SHADOW_H__
+
+#include <common.h>
+
+/* Shadow memory with one bit for each byte of pmem, which is set once the
+ * byte is written by the guest or loaded with the image. The shadow is
+ * mapped lazily by the host, so only the pages covering touched memory
+ * take space. An access of at most 8 bytes is covered by two adjacent
+ * shadow bytes, so it is checked with a single 16-bit load.
+ */
+extern uint8_t *shadow;
+
+void init_shadow();
+void shadow_define(paddr_t addr, size_t len);
+void shadow_undefined_read(paddr_t addr, int len);
+void shadow_report();
+
+static inline uint16_t shadow_mask(word_t off, int len) {
+  return ((1u << len) - 1) << (off & 7);
+}
+
+static inline void shadow_check(paddr_t addr, int len) {
+  word_t off = addr - CONFIG_MBASE;
+  uint16_t v, mask = shadow_mask(off, len);
+  memcpy(&v, shadow + (off >> 3), sizeof(v));
+  if (unlikely((v & mask) != mask)) shadow_undefined_read(addr, len);
+}
+
+static inline void shadow_set(paddr_t addr, int len) {
+  word_t off = addr - CONFIG_MBASE;
+  uint16_t mask = shadow_mask(off, len);
+  uint8_t *p = shadow + (off >> 3);
+#ifdef CONFIG_SMP_THREAD
+  // harts on other host threads may set bits in the same shadow byte
+  __atomic_fetch_or(p, (uint8_t)mask, __ATOMIC_RELAXED);
+  if (mask >> 8) __atomic_fetch_or(p + 1, (uint8_t)(mask >> 8), __ATOMIC_RELAXED);
+#else
+  p[0] |= mask;
+  if (mask >> 8) p[1] |= mask >> 8;
+#endif
+}
+
+#endif
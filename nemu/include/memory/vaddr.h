@@ -21,6 +21,8 @@
 word_t vaddr_ifetch(vaddr_t addr, int len);
 word_t vaddr_read(vaddr_t addr, int len);
 void vaddr_write(vaddr_t addr, int len, word_t data);
+word_t vaddr_amo(vaddr_t addr, int len, int op, word_t data);
+bool vaddr_cas(vaddr_t addr, int len, word_t expected, word_t data);
 
 #define PAGE_SHIFT        12
 #define PAGE_SIZE         (1ul << PAGE_SHIFT)
@@ -0,0 +1,52 @@
+/***************************************************************************************
+* Copyright (c) 2014-2024 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#ifndef __MEMORY_WATCH_H__
+#define __MEMORY_WATCH_H__
+
+#include <common.h>
+#include <memory/vaddr.h>
+
+enum { WATCH_R = 1, WATCH_W = 2, WATCH_RW = 3 };
+
+/* Writes to pmem are checked against the sorted addresses read by the
+ * watchpoints of sdb, so the watchpoints only reading memory are not
+ * evaluated after each instruction. See src/monitor/sdb/watchpoint.c.
+ */
+extern int nr_wp_addr;
+void wp_mem_write(paddr_t addr, int len);
+
+/* Pages overlapping a range watchpoint (watch-range) are marked in a
+ * bitmap, and only accesses to marked pages search the ranges.
+ */
+#define WATCH_NR_PAGE (CONFIG_MSIZE >> PAGE_SHIFT)
+extern int nr_watch_range;
+extern uint8_t watch_page_map[WATCH_NR_PAGE / 8];
+void watch_range_access(paddr_t addr, int len, int type, word_t data);
+
+static inline bool watch_page(paddr_t addr) {
+  paddr_t pg = (addr - CONFIG_MBASE) >> PAGE_SHIFT;
+  return pg < WATCH_NR_PAGE && ((watch_page_map[pg >> 3] >> (pg & 7)) & 1);
+}
+
+// `data' is the value to write, AMOs are passed as WATCH_RW
+static inline void watch_access(paddr_t addr, int len, int type, word_t data) {
+  if (unlikely(nr_wp_addr > 0) && (type & WATCH_W)) wp_mem_write(addr, len);
+  if (unlikely(nr_watch_range > 0) && (watch_page(addr) || watch_page(addr + len - 1))) {
+    watch_range_access(addr, len, type, data);
+  }
+}
+
+#endif
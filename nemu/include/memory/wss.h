@@ -0,0 +1,64 @@
+/***************************************************************************************
+* Copyright (c) 2014-2024 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#ifndef __MEMORY_WSS_H__
+#define __MEMORY_WSS_H__
+
+#include <common.h>
+
+/* Working set and reuse distance analysis of the instruction and data
+ * streams. Accesses to the physical memory are counted per cache line and
+ * per page, and the reuse distance of an access is the number of distinct
+ * lines accessed since the last access to the same line. The results of
+ * every CONFIG_WSS_INTERVAL instructions are appended to the file given
+ * by --wss (little endian):
+ *
+ *   header:   "NEMUWSS1", uint32_t line shift, uint32_t page shift,
+ *             uint32_t number of histogram buckets, uint32_t reserved,
+ *             uint64_t base address of the physical memory
+ *   interval: uint64_t first instruction, uint64_t number of instructions,
+ *             then for the instruction and the data streams:
+ *               uint64_t accesses, distinct lines, distinct pages,
+ *               uint64_t histogram[number of buckets]
+ *             then the page heat map as columns:
+ *               uint32_t nr, uint32_t page index[nr], uint32_t accesses[nr]
+ *
+ * Bucket 0 of the histogram counts the first accesses to lines, bucket 1
+ * counts reuse distance 0, and bucket k > 1 counts [2^(k-2), 2^(k-1)).
+ * Use tools/nemu-wss to print the file.
+ */
+enum { WSS_INST, WSS_DATA, NR_WSS_STREAM };
+
+#define WSS_LINE_SHIFT 6
+#define WSS_PAGE_SHIFT 12
+#define WSS_NR_BUCKET 32
+
+extern bool wss_on;
+extern uint64_t wss_next; // instruction count at the end of the interval
+
+void init_wss(const char *file);
+void wss_record(int stream, paddr_t addr);
+void wss_interval();
+void wss_close();
+
+static inline void wss_access(int stream, paddr_t addr) {
+  if (unlikely(wss_on)) wss_record(stream, addr);
+}
+
+static inline void wss_check(uint64_t nr_inst) {
+  if (nr_inst >= wss_next) wss_interval();
+}
+
+#endif
@@ -0,0 +1,81 @@
+/***************************************************************************************
+* Copyright (c) 2014-2024 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#ifndef __NEMU_PLUGIN_H__
+#define __NEMU_PLUGIN_H__
+
+/* ABI of NEMU plugins. This header is self-contained, so plugins can be
+ * built outside of NEMU. A plugin is a shared object loaded by --plugin,
+ * which exports
+ *
+ *   int nemu_plugin_install(const char *args, NemuPluginCallbacks *cb);
+ *
+ * It fills in the callbacks it subscribes to and returns 0, or returns
+ * non-zero to refuse to be loaded. Callbacks left NULL cost nothing.
+ * New fields are only appended, and NEMU sets `size' to the size of the
+ * structure it knows, so an older plugin keeps working. In turn, a plugin
+ * must check NEMU_PLUGIN_HAS() before touching a field appended after
+ * version 1, since an older NEMU does not have it.
+ */
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define NEMU_PLUGIN_VERSION 1
+
+// an event delivered to `async_events'
+enum { NEMU_EV_INST, NEMU_EV_LOAD, NEMU_EV_STORE, NEMU_EV_BRANCH };
+typedef struct {
+  uint8_t kind;
+  uint8_t len;   // size of a memory access
+  uint8_t taken; // outcome of a branch
+  uint64_t pc;
+  uint64_t addr; // address of a memory access, or target of a taken branch
+} NemuPluginEvent;
+
+typedef struct {
+  uint32_t version; // NEMU_PLUGIN_VERSION of NEMU
+  uint32_t size;    // sizeof(NemuPluginCallbacks) of NEMU
+  void *udata;      // passed to every callback
+
+  // a block of `nr_inst' instructions starting from `pc' is executed
+  void (*block_exec)(void *udata, uint64_t pc, uint64_t nr_inst);
+  // an instruction is executed
+  void (*inst_exec)(void *udata, uint64_t pc, uint32_t inst);
+  // a data access by the guest, `data' is the value read or written
+  void (*mem_access)(void *udata, uint64_t vaddr, int len, bool is_write, uint64_t data);
+  // an access to device `dev'
+  void (*mmio_access)(void *udata, const char *dev, uint64_t paddr, int len, bool is_write, uint64_t data);
+  // an exception or interrupt `cause' is taken at `epc'
+  void (*trap)(void *udata, uint64_t epc, uint64_t cause);
+  // NEMU exits, after all asynchronous events are delivered
+  void (*exit)(void *udata);
+
+  // appended after version 1, check NEMU_PLUGIN_HAS(cb, async_drop) first
+
+  // executed instructions, data accesses and branch outcomes, delivered in
+  // batches on a separate host thread (only with CONFIG_PIPELINE)
+  void (*async_events)(void *udata, const NemuPluginEvent *ev, int nr);
+  // drop events rather than stalling the guest if `async_events' falls behind
+  bool async_drop;
+} NemuPluginCallbacks;
+
+// whether the NEMU loading the plugin knows `field' of NemuPluginCallbacks
+#define NEMU_PLUGIN_HAS(cb, field) \
+  ((cb)->size >= offsetof(NemuPluginCallbacks, field) + sizeof((cb)->field))
+
+typedef int (*nemu_plugin_install_t)(const char *args, NemuPluginCallbacks *cb);
+
+#endif
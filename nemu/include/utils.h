@@ -34,6 +34,65 @@ extern NEMUState nemu_state;
 
 uint64_t get_time();
 
+// ----------- timeline -----------
+
+#ifdef CONFIG_TIMELINE
+/* Events for the Chrome trace-event timeline written by --timeline. Guest
+ * events are stamped with the number of guest instructions, and host
+ * phases with get_time(), so they are shown as two processes.
+ */
+enum { TL_GUEST_FUNC, TL_GUEST_MMIO, TL_GUEST_INTR, TL_HOST };
+
+extern bool timeline_on;
+void timeline_guest(int kind, char ph, const char *name, uint64_t arg);
+void timeline_host(const char *name, uint64_t start, uint64_t dur);
+void timeline_flush_thread();
+void timeline_close();
+
+// run the statements as a host phase called `name'
+#define timeline_phase(name, ...) do { \
+  uint64_t __tl_start = (timeline_on ? get_time() : 0); \
+  __VA_ARGS__; \
+  if (timeline_on) timeline_host(name, __tl_start, get_time() - __tl_start); \
+} while (0)
+#else
+#define timeline_phase(name, ...) do { __VA_ARGS__; } while (0)
+#endif
+
+// ----------- host profiler -----------
+
+#ifdef CONFIG_HOST_PROF
+/* Host time spent in each phase of the simulator. Every HOST_PROF_INTERVAL
+ * instructions, one instruction is timed phase by phase, and the time of a
+ * phase excludes the phases nested in it.
+ */
+enum { HP_LOOP, HP_FETCH, HP_DECODE, HP_EXEC, HP_MEM, HP_MMIO, HP_TRACE,
+  HP_DIFFTEST, HP_DEVICE, NR_HP };
+
+extern bool hprof_sampling;
+extern int hprof_countdown;
+void hprof_enter(int phase);
+void hprof_leave();
+void hprof_inst_end();
+void hprof_report();
+
+static inline void hprof_inst_begin() {
+  if (-- hprof_countdown == 0) {
+    hprof_countdown = CONFIG_HOST_PROF_INTERVAL;
+    hprof_sampling = true;
+    hprof_enter(HP_LOOP);
+  }
+}
+
+// run the statements as `phase' if the current instruction is sampled
+#define hprof_phase(phase, ...) do { \
+  if (unlikely(hprof_sampling)) { hprof_enter(phase); __VA_ARGS__; hprof_leave(); } \
+  else { __VA_ARGS__; } \
+} while (0)
+#else
+#define hprof_phase(phase, ...) do { __VA_ARGS__; } while (0)
+#endif
+
 // ----------- log -----------
 
 #define ANSI_FG_BLACK   "\33[1;30m"
@@ -56,13 +115,28 @@ uint64_t get_time();
 
 #define ANSI_FMT(str, fmt) fmt str ANSI_NONE
 
+enum { LOG_LV_ERROR, LOG_LV_WARN, LOG_LV_INFO, LOG_LV_DEBUG };
+// modules whose debug messages can be enabled separately
+enum { LOG_ISA, LOG_CPU, LOG_MEM, LOG_DEV, LOG_SDB, NR_LOG_MOD };
+
+extern int log_level;
+extern uint32_t log_debug_mods;
+
+#ifdef CONFIG_LOG_ASYNC
+void log_write_async(const char *fmt, ...);
+#define _log_printf(...) log_write_async(__VA_ARGS__)
+#else
+#define _log_printf(...) fprintf(log_fp, __VA_ARGS__)
+#endif
+
+// log_fp is fully buffered, it is flushed on exit and by Assert()
+void log_flush();
 #define log_write(...) IFDEF(CONFIG_TARGET_NATIVE_ELF, \
   do { \
     extern FILE* log_fp; \
     extern bool log_enable(); \
     if (log_enable() && log_fp != NULL) { \
-      fprintf(log_fp, __VA_ARGS__); \
-      fflush(log_fp); \
+      _log_printf(__VA_ARGS__); \
     } \
   } while (0) \
 )
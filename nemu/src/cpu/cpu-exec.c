@@ -16,7 +16,23 @@
 #include <cpu/cpu.h>
 #include <cpu/decode.h>
 #include <cpu/difftest.h>
+#include <cpu/itrace.h>
+#include <cpu/ftrace.h>
+#include <cpu/profile.h>
+#include <cpu/inststat.h>
+#include <cpu/coverage.h>
+#include <cpu/plugin.h>
+#include <cpu/pipeline.h>
+#include <cpu/bpred.h>
+#include <cpu/timing.h>
+#include <cpu/reverse.h>
+#include <memory/cachesim.h>
+#include <memory/wss.h>
+#include <memory/shadow.h>
 #include <locale.h>
+#ifdef CONFIG_SMP
+#include <pthread.h>
+#endif
 
 // make the watchpoint work
 #include "../monitor/sdb/sdb.h"
@@ -27,19 +43,96 @@
  */
 #define MAX_INST_TO_PRINT 10
 
-CPU_state cpu = {};
-uint64_t g_nr_guest_inst = 0;
+MUXDEF(CONFIG_SMP_THREAD, __thread, ) CPU_state cpu = {};
+MUXDEF(CONFIG_SMP_THREAD, __thread, ) uint64_t g_nr_guest_inst = 0;
 static uint64_t g_timer = 0; // unit: us
 static bool g_print_step = false;
 
+#ifdef CONFIG_SMP
+/* A hart which is not running in `cpu' is parked in `harts'. Outside of
+ * cpu_exec(), `cpu' always holds hart 0, so the monitor sees the boot hart.
+ */
+static CPU_state harts[CONFIG_NR_HART] = {};
+static bool hart_started[CONFIG_NR_HART] = { [0] = true };
+static MUXDEF(CONFIG_SMP_THREAD, __thread, ) int cur_hart = 0;
+
+int hart_id() { return cur_hart; }
+#endif
+
+#define NR_HARTS MUXDEF(CONFIG_SMP, CONFIG_NR_HART, 1)
+#define CUR_HART MUXDEF(CONFIG_SMP, cur_hart, 0)
+/* Pending interrupt lines of each hart. Devices set them, possibly from a
+ * signal handler or another host thread, and the exec loop collects them
+ * only at block boundaries instead of polling for every instruction.
+ */
+static uint32_t intr_lines[NR_HARTS] = {};
+
+void cpu_raise_intr(int line) {
+  for (int i = 0; i < NR_HARTS; i ++) {
+    __atomic_fetch_or(&intr_lines[i], 1u << line, __ATOMIC_RELAXED);
+  }
+}
+
+uint32_t cpu_fetch_intr() {
+  // the lines are replayed by reverse execution, and the pending ones are left for later
+  IFDEF(CONFIG_REVERSE, if (!rev_live()) return rev_intr_lines(0));
+  uint32_t *p = &intr_lines[CUR_HART];
+  uint32_t lines = (*p == 0 ? 0 : __atomic_exchange_n(p, 0, __ATOMIC_RELAXED));
+  return MUXDEF(CONFIG_REVERSE, rev_intr_lines(lines), lines);
+}
+
+/* Retired instructions and HPM events of each hart. The exec loop only
+ * bumps thread-local counters, which are folded into the current hart at
+ * block boundaries, so a hart switch never mixes the counts up.
+ */
+static MUXDEF(CONFIG_SMP_THREAD, __thread, ) uint64_t block_start_inst = 0;
+static uint64_t hart_instret[NR_HARTS] = {};
+#ifdef CONFIG_HPM
+MUXDEF(CONFIG_SMP_THREAD, __thread, ) uint64_t hpm_block_event[NR_HPM_EV] = {};
+static uint64_t hart_hpm_event[NR_HARTS][NR_HPM_EV] = {};
+#endif
+
+uint64_t cpu_instret() {
+  return hart_instret[CUR_HART] + (g_nr_guest_inst - block_start_inst);
+}
+
+uint64_t cpu_hpm_event(int ev) {
+  return MUXDEF(CONFIG_HPM, hart_hpm_event[CUR_HART][ev] + hpm_block_event[ev], 0);
+}
+
+#ifdef CONFIG_REVERSE
+// move to instruction `n' when a checkpoint is restored
+void cpu_set_inst_count(uint64_t n) {
+  g_nr_guest_inst = n;
+  hart_instret[0] = n;
+  block_start_inst = n;
+}
+#endif
+
+static void fold_block_counters() {
+  hart_instret[CUR_HART] += g_nr_guest_inst - block_start_inst;
+  block_start_inst = g_nr_guest_inst;
+#ifdef CONFIG_HPM
+  for (int i = 0; i < NR_HPM_EV; i ++) {
+    hart_hpm_event[CUR_HART][i] += hpm_block_event[i];
+    hpm_block_event[i] = 0;
+  }
+#endif
+}
+
 void device_update();
 
 static void trace_and_difftest(Decode *_this, vaddr_t dnpc) {
 #ifdef CONFIG_ITRACE_COND
   if (ITRACE_COND) { log_write("%s\n", _this->logbuf); }
 #endif
+  IFDEF(CONFIG_IQUEUE, iqueue_push(_this));
+  IFDEF(CONFIG_INST_STAT, inst_stat_pc(_this->pc));
+  IFDEF(CONFIG_COVERAGE, cov_exec(_this->pc));
+  IFDEF(CONFIG_ITRACE_BIN, itrace_write(_this));
   if (g_print_step) { IFDEF(CONFIG_ITRACE, puts(_this->logbuf)); }
-  IFDEF(CONFIG_DIFFTEST, difftest_step(_this->pc, dnpc));
+  IFDEF(CONFIG_DIFFTEST, timeline_phase("difftest_step",
+        hprof_phase(HP_DIFFTEST, difftest_step(_this->pc, dnpc))));
 }
 
 static void exec_once(Decode *s, vaddr_t pc) {
@@ -73,17 +166,148 @@ static void exec_once(Decode *s, vaddr_t pc) {
 #endif
 }
 
-static void execute(uint64_t n) {
-  Decode s;
-  for (;n > 0; n --) {
-    exec_once(&s, cpu.pc);
+/* `slow' is a constant at each call site, so the loop testing breakpoints
+ * and watchpoints and calling the instruction callback of plugins is a
+ * separate copy, and the default one does not even test for them.
+ */
+static inline __attribute__((always_inline))
+void exec_block(Decode *s, uint64_t block, bool slow) {
+  for (; block > 0; block --) {
+    if (slow && nr_bp > 0 && bp_hit(cpu.pc, g_nr_guest_inst)) {
+      nemu_state.state = NEMU_STOP;
+      break;
+    }
+    IFDEF(CONFIG_HOST_PROF, hprof_inst_begin());
+    exec_once(s, cpu.pc);
     g_nr_guest_inst ++;
-    trace_and_difftest(&s, cpu.pc);
+    IFDEF(CONFIG_PLUGIN, if (slow && plugin_on[PLUGIN_EV_INST]) plugin_inst_exec(s->pc, s->isa.inst));
+    pipe_put(PIPE_INST, s->pc, 0, 0, false);
+    hprof_phase(HP_TRACE, trace_and_difftest(s, cpu.pc));
+    IFDEF(CONFIG_HOST_PROF, hprof_inst_end());
+    if (slow && wp_pending() && check_watchpoint(s->pc) &&
+        nemu_state.state == NEMU_RUNNING) nemu_state.state = NEMU_STOP;
     if (nemu_state.state != NEMU_RUNNING) break;
-    IFDEF(CONFIG_DEVICE, device_update());
   }
 }
 
+static void execute(uint64_t n) {
+  Decode s;
+  block_start_inst = g_nr_guest_inst;
+  IFDEF(CONFIG_REVERSE, rev_check(g_nr_guest_inst));
+  while (n > 0) {
+    uint64_t block = (n < CONFIG_EXEC_BLOCK_SIZE ? n : CONFIG_EXEC_BLOCK_SIZE);
+    n -= block;
+    IFDEF(CONFIG_PLUGIN, vaddr_t block_pc = cpu.pc);
+    if (nr_bp > 0 || MUXDEF(CONFIG_SMP_THREAD, false, nr_wp > 0) ||
+        MUXDEF(CONFIG_PLUGIN, plugin_on[PLUGIN_EV_INST], false)) exec_block(&s, block, true);
+    else exec_block(&s, block, false);
+
+    // block boundary
+    plugin_event(PLUGIN_EV_BLOCK, plugin_block_exec(block_pc, g_nr_guest_inst - block_start_inst));
+    fold_block_counters();
+    IFDEF(CONFIG_PROFILE, profile_check(g_nr_guest_inst));
+    IFDEF(CONFIG_WSS, wss_check(g_nr_guest_inst));
+    if (nemu_state.state != NEMU_RUNNING) return;
+    word_t intr = MUXDEF(CONFIG_REVERSE, rev_query_intr(), isa_query_intr());
+    if (intr != INTR_EMPTY) {
+      IFDEF(CONFIG_TIMELINE, timeline_guest(TL_GUEST_INTR, 'i', "interrupt", intr));
+      cpu.pc = isa_raise_intr(intr, cpu.pc);
+      IFDEF(CONFIG_DIFFTEST, ref_difftest_raise_intr(intr));
+    }
+    // devices (and SDL) are only driven by the thread running hart 0
+    IFDEF(CONFIG_DEVICE, if (MUXDEF(CONFIG_SMP_THREAD, cur_hart == 0, rev_live())) {
+      IFDEF(CONFIG_HOST_PROF, hprof_enter(HP_DEVICE));
+      device_update();
+      IFDEF(CONFIG_HOST_PROF, hprof_leave());
+    });
+    IFDEF(CONFIG_REVERSE, rev_check(g_nr_guest_inst));
+  }
+}
+
+#ifdef CONFIG_SMP
+static pthread_mutex_t hart_lock = PTHREAD_MUTEX_INITIALIZER;
+
+#ifdef CONFIG_SMP_THREAD
+static pthread_t hart_thread[CONFIG_NR_HART] = {};
+static bool hart_spawned[CONFIG_NR_HART] = {};
+static uint64_t hart_nr_inst[CONFIG_NR_HART] = {};
+static uint64_t hart_quota = 0; // instructions each hart may run in this cpu_exec()
+
+static void *hart_main(void *arg) {
+  cur_hart = (intptr_t)arg;
+  cpu = harts[cur_hart];
+  execute(hart_quota);
+  IFDEF(CONFIG_TIMELINE, timeline_flush_thread());
+  harts[cur_hart] = cpu;
+  hart_nr_inst[cur_hart] = g_nr_guest_inst;
+  return NULL;
+}
+
+// should be called with `hart_lock' held
+static void hart_spawn(int id) {
+  hart_spawned[id] = true;
+  int ret = pthread_create(&hart_thread[id], NULL, hart_main, (void *)(intptr_t)id);
+  Assert(ret == 0, "Can not create host thread for hart %d", id);
+}
+
+static void execute_smp(uint64_t n) {
+  hart_quota = n;
+  pthread_mutex_lock(&hart_lock);
+  for (int i = 1; i < CONFIG_NR_HART; i ++) {
+    if (hart_started[i]) hart_spawn(i);
+  }
+  pthread_mutex_unlock(&hart_lock);
+
+  // hart 0 runs on the calling thread
+  execute(n);
+
+  for (int i = 1; i < CONFIG_NR_HART; i ++) {
+    pthread_mutex_lock(&hart_lock);
+    bool spawned = hart_spawned[i];
+    hart_spawned[i] = false;
+    pthread_mutex_unlock(&hart_lock);
+    if (!spawned) continue;
+    pthread_join(hart_thread[i], NULL);
+    g_nr_guest_inst += hart_nr_inst[i];
+  }
+}
+#else
+static void execute_smp(uint64_t n) {
+  harts[0] = cpu;
+  while (n > 0 && nemu_state.state == NEMU_RUNNING) {
+    uint64_t slice = (n < CONFIG_SMP_QUANTUM ? n : CONFIG_SMP_QUANTUM);
+    for (int i = 0; i < CONFIG_NR_HART && nemu_state.state == NEMU_RUNNING; i ++) {
+      if (!hart_started[i]) continue;
+      cur_hart = i;
+      cpu = harts[i];
+      execute(slice);
+      harts[i] = cpu;
+    }
+    n -= slice;
+  }
+  cur_hart = 0;
+  cpu = harts[0];
+}
+#endif
+
+void hart_start(int id, vaddr_t pc, word_t sp) {
+  // the id comes from the guest, so a bad one is ignored
+  if (id <= 0 || id >= CONFIG_NR_HART) {
+    Warn("can not start hart %d, valid ids are [1, %d]", id, CONFIG_NR_HART - 1);
+    return;
+  }
+  pthread_mutex_lock(&hart_lock);
+  if (hart_started[id]) {
+    Warn("hart %d is already started", id);
+  } else {
+    isa_hart_init(&harts[id], id, pc, sp);
+    hart_started[id] = true;
+    IFDEF(CONFIG_SMP_THREAD, if (nemu_state.state == NEMU_RUNNING) hart_spawn(id));
+  }
+  pthread_mutex_unlock(&hart_lock);
+}
+#endif
+
 static void statistic() {
   IFNDEF(CONFIG_TARGET_AM, setlocale(LC_NUMERIC, ""));
 #define NUMBERIC_FMT MUXDEF(CONFIG_TARGET_AM, "%", "%'") PRIu64
@@ -91,18 +315,31 @@ static void statistic() {
   Log("total guest instructions = " NUMBERIC_FMT, g_nr_guest_inst);
   if (g_timer > 0) Log("simulation frequency = " NUMBERIC_FMT " inst/s", g_nr_guest_inst * 1000000 / g_timer);
   else Log("Finish running in less than 1 us and can not calculate the simulation frequency");
+  IFDEF(CONFIG_INST_STAT, inst_stat_report());
+  IFDEF(CONFIG_HOST_PROF, hprof_report());
+  IFDEF(CONFIG_CACHESIM, cachesim_report());
+  IFDEF(CONFIG_BPRED, bpred_report());
+  IFDEF(CONFIG_TIMING, timing_report());
+  IFDEF(CONFIG_MEM_SHADOW, shadow_report());
 }
 
 void assert_fail_msg() {
   isa_reg_display();
   statistic();
+  IFDEF(CONFIG_IQUEUE, iqueue_dump());
+  IFDEF(CONFIG_ITRACE_BIN, itrace_close());
+  IFDEF(CONFIG_FTRACE, ftrace_close());
+  IFDEF(CONFIG_PROFILE, profile_dump());
+  IFDEF(CONFIG_COVERAGE, coverage_dump());
+  IFDEF(CONFIG_WSS, wss_close());
+  IFDEF(CONFIG_TIMELINE, timeline_close());
+  IFNDEF(CONFIG_TARGET_AM, log_flush());
 }
 
 /* Simulate how the CPU works. */
 void cpu_exec(uint64_t n) {
-  g_print_step = (n < MAX_INST_TO_PRINT);
-  Log("EXEC CPU");
-  check_watchpoint();
+  g_print_step = (n < MAX_INST_TO_PRINT) && rev_live();
+  Debug(LOG_CPU, "EXEC CPU");
   switch (nemu_state.state) {
     case NEMU_END: case NEMU_ABORT: case NEMU_QUIT:
       printf("Program execution has ended. To restart the program, exit NEMU and run again.\n");
@@ -110,9 +347,13 @@ void cpu_exec(uint64_t n) {
     default: nemu_state.state = NEMU_RUNNING;
   }
 
+  bp_start_inst = g_nr_guest_inst;
   uint64_t timer_start = get_time();
 
-  execute(n);
+  timeline_phase("cpu_exec", MUXDEF(CONFIG_SMP, execute_smp(n), execute(n)));
+  IFDEF(CONFIG_SMP_THREAD, check_watchpoint(cpu.pc));
+  // let the consumers catch up while the monitor has the control
+  IFDEF(CONFIG_PIPELINE, if (pipeline_on && pipe_nr > 0) pipeline_publish());
 
   uint64_t timer_end = get_time();
   g_timer += timer_end - timer_start;
@@ -126,6 +367,9 @@ void cpu_exec(uint64_t n) {
            (nemu_state.halt_ret == 0 ? ANSI_FMT("HIT GOOD TRAP", ANSI_FG_GREEN) :
             ANSI_FMT("HIT BAD TRAP", ANSI_FG_RED))),
           nemu_state.halt_pc);
+      if (nemu_state.state == NEMU_ABORT || nemu_state.halt_ret != 0) {
+        IFDEF(CONFIG_IQUEUE, iqueue_dump());
+      }
       // fall through
     case NEMU_QUIT: statistic();
   }
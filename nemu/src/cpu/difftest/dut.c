@@ -17,6 +17,7 @@
 
 #include <isa.h>
 #include <cpu/cpu.h>
+#include <cpu/itrace.h>
 #include <memory/paddr.h>
 #include <utils.h>
 #include <difftest-def.h>
@@ -95,6 +96,7 @@ static void checkregs(CPU_state *ref, vaddr_t pc) {
   if (!isa_difftest_checkregs(ref, pc)) {
     nemu_state.state = NEMU_ABORT;
     nemu_state.halt_pc = pc;
+    IFDEF(CONFIG_IQUEUE, iqueue_dump());
     isa_reg_display();
   }
 }
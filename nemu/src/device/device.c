@@ -23,6 +23,7 @@
 void init_map();
 void init_serial();
 void init_timer();
+void init_mpe();
 void init_vga();
 void init_i8042();
 void init_audio();
@@ -33,15 +34,8 @@ void init_alarm();
 void send_key(uint8_t, bool);
 void vga_update_screen();
 
-void device_update() {
-  static uint64_t last = 0;
-  uint64_t now = get_time();
-  if (now - last < 1000000 / TIMER_HZ) {
-    return;
-  }
-  last = now;
-
-  IFDEF(CONFIG_HAS_VGA, vga_update_screen());
+static void update_devices() {
+  IFDEF(CONFIG_HAS_VGA, timeline_phase("vga_update_screen", vga_update_screen()));
 
 #ifndef CONFIG_TARGET_AM
   SDL_Event event;
@@ -66,6 +60,18 @@ void device_update() {
 #endif
 }
 
+void device_update() {
+  static uint64_t last = 0;
+  uint64_t now = get_time();
+  if (now - last < 1000000 / TIMER_HZ) {
+    return;
+  }
+  last = now;
+
+  // only the calls doing the work are shown, not the ones per block
+  timeline_phase("device_update", update_devices());
+}
+
 void sdl_clear_event_queue() {
 #ifndef CONFIG_TARGET_AM
   SDL_Event event;
@@ -79,6 +85,7 @@ void init_device() {
 
   IFDEF(CONFIG_HAS_SERIAL, init_serial());
   IFDEF(CONFIG_HAS_TIMER, init_timer());
+  IFDEF(CONFIG_HAS_MPE, init_mpe());
   IFDEF(CONFIG_HAS_VGA, init_vga());
   IFDEF(CONFIG_HAS_KEYBOARD, init_i8042());
   IFDEF(CONFIG_HAS_AUDIO, init_audio());
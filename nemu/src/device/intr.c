@@ -14,6 +14,8 @@
 ***************************************************************************************/
 
 #include <isa.h>
+#include <cpu/cpu.h>
 
-void dev_raise_intr() {
+void dev_raise_intr(int line) {
+  cpu_raise_intr(line);
 }
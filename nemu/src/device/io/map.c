@@ -17,6 +17,7 @@
 #include <memory/host.h>
 #include <memory/vaddr.h>
 #include <device/map.h>
+#include <cpu/plugin.h>
 
 #define IO_SPACE_MAX (32 * 1024 * 1024)
 
@@ -56,8 +57,10 @@ word_t map_read(paddr_t addr, int len, IOMap *map) {
   assert(len >= 1 && len <= 8);
   check_bound(map, addr);
   paddr_t offset = addr - map->low;
-  invoke_callback(map->callback, offset, len, false); // prepare data to read
+  IFDEF(CONFIG_TIMELINE, timeline_guest(TL_GUEST_MMIO, 'i', map->name, addr));
+  hprof_phase(HP_MMIO, invoke_callback(map->callback, offset, len, false)); // prepare data to read
   word_t ret = host_read(map->space + offset, len);
+  plugin_event(PLUGIN_EV_MMIO, plugin_mmio_access(map->name, addr, len, false, ret));
   return ret;
 }
 
@@ -65,6 +68,8 @@ void map_write(paddr_t addr, int len, word_t data, IOMap *map) {
   assert(len >= 1 && len <= 8);
   check_bound(map, addr);
   paddr_t offset = addr - map->low;
+  IFDEF(CONFIG_TIMELINE, timeline_guest(TL_GUEST_MMIO, 'i', map->name, addr));
   host_write(map->space + offset, len, data);
-  invoke_callback(map->callback, offset, len, true);
+  hprof_phase(HP_MMIO, invoke_callback(map->callback, offset, len, true));
+  plugin_event(PLUGIN_EV_MMIO, plugin_mmio_access(map->name, addr, len, true, data));
 }
@@ -15,6 +15,14 @@
 
 #include <device/map.h>
 #include <memory/paddr.h>
+#include <cpu/cpu.h>
+#include <cpu/reverse.h>
+#ifdef CONFIG_SMP_THREAD
+#include <pthread.h>
+
+// devices are not thread-safe, so accesses from different harts are serialized
+static pthread_mutex_t mmio_lock = PTHREAD_MUTEX_INITIALIZER;
+#endif
 
 #define NR_MAP 16
 
@@ -55,9 +63,19 @@ void add_mmio_map(const char *name, paddr_t addr, void *space, uint32_t len, io_
 
 /* bus interface */
 word_t mmio_read(paddr_t addr, int len) {
-  return map_read(addr, len, fetch_mmio_map(addr));
+  hpm_count(HPM_EV_MMIO);
+  // devices are not touched by the replay of reverse execution
+  IFDEF(CONFIG_REVERSE, if (!rev_live()) return rev_replay());
+  IFDEF(CONFIG_SMP_THREAD, pthread_mutex_lock(&mmio_lock));
+  word_t ret = map_read(addr, len, fetch_mmio_map(addr));
+  IFDEF(CONFIG_SMP_THREAD, pthread_mutex_unlock(&mmio_lock));
+  return MUXDEF(CONFIG_REVERSE, rev_record(ret), ret);
 }
 
 void mmio_write(paddr_t addr, int len, word_t data) {
+  hpm_count(HPM_EV_MMIO);
+  IFDEF(CONFIG_REVERSE, if (!rev_live()) return);
+  IFDEF(CONFIG_SMP_THREAD, pthread_mutex_lock(&mmio_lock));
   map_write(addr, len, data, fetch_mmio_map(addr));
+  IFDEF(CONFIG_SMP_THREAD, pthread_mutex_unlock(&mmio_lock));
 }
@@ -0,0 +1,56 @@
+/***************************************************************************************
+* Copyright (c) 2014-2024 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+
+#include <device/map.h>
+#include <cpu/cpu.h>
+
+/* Multi-processor controller. A hart is started by selecting it with
+ * `hart_sel', writing its initial stack pointer to `start_sp', and then
+ * writing its entry address to `start_pc'.
+ */
+enum { reg_nr_hart, reg_hart_id, reg_hart_sel, reg_start_sp, reg_start_pc, nr_reg };
+
+static uint32_t *mpe_base = NULL;
+
+static void mpe_io_handler(uint32_t offset, int len, bool is_write) {
+  assert(len == 4);
+  switch (offset / 4) {
+    case reg_hart_id:
+      if (!is_write) mpe_base[reg_hart_id] = MUXDEF(CONFIG_SMP, hart_id(), 0);
+      break;
+    case reg_start_pc:
+      if (is_write) {
+#ifdef CONFIG_SMP
+        hart_start(mpe_base[reg_hart_sel], mpe_base[reg_start_pc], mpe_base[reg_start_sp]);
+#else
+        Warn("can not start hart %d without SMP support", mpe_base[reg_hart_sel]);
+#endif
+      }
+      break;
+    default: break; // plain registers
+  }
+}
+
+void init_mpe() {
+  uint32_t space_size = sizeof(uint32_t) * nr_reg;
+  mpe_base = (uint32_t *)new_space(space_size);
+  mpe_base[reg_nr_hart] = MUXDEF(CONFIG_SMP, CONFIG_NR_HART, 1);
+#ifdef CONFIG_HAS_PORT_IO
+  add_pio_map ("mpe", CONFIG_MPE_PORT, mpe_base, space_size, mpe_io_handler);
+#else
+  add_mmio_map("mpe", CONFIG_MPE_MMIO, mpe_base, space_size, mpe_io_handler);
+#endif
+}
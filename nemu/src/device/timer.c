@@ -16,6 +16,7 @@
 #include <device/map.h>
 #include <device/alarm.h>
 #include <utils.h>
+#include <cpu/cpu.h>
 
 static uint32_t *rtc_port_base = NULL;
 
@@ -31,8 +32,8 @@ static void rtc_io_handler(uint32_t offset, int len, bool is_write) {
 #ifndef CONFIG_TARGET_AM
 static void timer_intr() {
   if (nemu_state.state == NEMU_RUNNING) {
-    extern void dev_raise_intr();
-    dev_raise_intr();
+    extern void dev_raise_intr(int line);
+    dev_raise_intr(INTR_LINE_TIMER);
   }
 }
 #endif
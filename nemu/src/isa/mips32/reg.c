@@ -32,14 +32,16 @@ void isa_reg_display() {
 }
 
 word_t isa_reg_str2val(const char *s, bool *success) {
-  // for (size_t i = 0; i < sizeof(regs) / sizeof(regs[0]); i++)
-  // {
-  //   if (strcmp(s, regs[i]) == 0) {
-  //     // get that value in the reg
-  //     *success = true;
-  //     return i;
-  //   }
-  // }
-  
-  return 0;
+  word_t *reg = isa_reg_ptr(s);
+  *success = (reg != NULL);
+  return (reg ? *reg : 0);
+}
+
+word_t *isa_reg_ptr(const char *s) {
+  if (s[0] == '$') s ++; // as written in sdb expressions
+  if (strcmp(s, "pc") == 0) return &cpu.pc;
+  for (size_t i = 0; i < sizeof(regs) / sizeof(regs[0]); i++) {
+    if (strcmp(s, regs[i]) == 0) return &cpu.gpr[i];
+  }
+  return NULL;
 }
@@ -0,0 +1,128 @@
+/***************************************************************************************
+* Copyright (c) 2014-2024 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#include <isa.h>
+#include <cpu/decode.h>
+#include "local-include/reg.h"
+#include "local-include/inst.h"
+
+static const char *csr_name(int no) {
+  switch (no) {
+    case CSR_MSTATUS: return "mstatus";
+    case CSR_MIE:     return "mie";
+    case CSR_MTVEC:   return "mtvec";
+    case CSR_MEPC:    return "mepc";
+    case CSR_MCAUSE:  return "mcause";
+    case CSR_MIP:     return "mip";
+    case CSR_MHARTID: return "mhartid";
+    case CSR_MCYCLE:  return "mcycle";
+    case CSR_MINSTRET: return "minstret";
+    case CSR_CYCLE:   return "cycle";
+    case CSR_TIME:    return "time";
+    case CSR_INSTRET: return "instret";
+    default: return NULL;
+  }
+}
+
+// the operands are decoded from the encoding defined by the spec
+static void format(char *str, int size, const char *name, int type, vaddr_t pc, uint32_t i) {
+  const char *rd = reg_name(BITS(i, 11, 7));
+  const char *rs1 = reg_name(BITS(i, 19, 15));
+  const char *rs2 = reg_name(BITS(i, 24, 20));
+  uint32_t opcode = BITS(i, 6, 0), funct3 = BITS(i, 14, 12);
+  sword_t imm;
+
+  switch (type) {
+    case TYPE_R:
+      if (opcode == 0x2f) { // A extension
+        if (BITS(i, 31, 27) == 0x02) snprintf(str, size, "%s\t%s, (%s)", name, rd, rs1);
+        else snprintf(str, size, "%s\t%s, %s, (%s)", name, rd, rs2, rs1);
+      } else {
+        snprintf(str, size, "%s\t%s, %s, %s", name, rd, rs1, rs2);
+      }
+      break;
+    case TYPE_I:
+      imm = SEXT(BITS(i, 31, 20), 12);
+      if (opcode == 0x03 || opcode == 0x67) { // loads and jalr
+        snprintf(str, size, "%s\t%s, %d(%s)", name, rd, imm, rs1);
+      } else if (opcode == 0x73) {
+        int no = BITS(i, 31, 20);
+        const char *csr = csr_name(no);
+        char csr_buf[8];
+        if (csr == NULL) { snprintf(csr_buf, sizeof(csr_buf), "0x%03x", no); csr = csr_buf; }
+        if (funct3 == 0) snprintf(str, size, "%s", name);
+        else if (funct3 & 0x4) snprintf(str, size, "%s\t%s, %s, %d", name, rd, csr, (int)BITS(i, 19, 15));
+        else snprintf(str, size, "%s\t%s, %s, %s", name, rd, csr, rs1);
+      } else if (funct3 == 1 || funct3 == 5) { // shifts
+        snprintf(str, size, "%s\t%s, %s, %d", name, rd, rs1, (int)BITS(i, 24, 20));
+      } else {
+        snprintf(str, size, "%s\t%s, %s, %d", name, rd, rs1, imm);
+      }
+      break;
+    case TYPE_S:
+      imm = (SEXT(BITS(i, 31, 25), 7) << 5) | BITS(i, 11, 7);
+      snprintf(str, size, "%s\t%s, %d(%s)", name, rs2, imm, rs1);
+      break;
+    case TYPE_B:
+      imm = (SEXT(BITS(i, 31, 31), 1) << 12) | (BITS(i, 7, 7) << 11) |
+            (BITS(i, 30, 25) << 5) | (BITS(i, 11, 8) << 1);
+      snprintf(str, size, "%s\t%s, %s, " FMT_WORD, name, rs1, rs2, pc + imm);
+      break;
+    case TYPE_U:
+      snprintf(str, size, "%s\t%s, 0x%x", name, rd, (uint32_t)BITS(i, 31, 12));
+      break;
+    case TYPE_J:
+      imm = (SEXT(BITS(i, 31, 31), 1) << 20) | (BITS(i, 19, 12) << 12) |
+            (BITS(i, 20, 20) << 11) | (BITS(i, 30, 21) << 1);
+      snprintf(str, size, "%s\t%s, " FMT_WORD, name, rd, pc + imm);
+      break;
+    default: snprintf(str, size, "%s", name); break;
+  }
+}
+
+static void disasm_inst(char *out, int size, vaddr_t pc, uint32_t inst) {
+#undef INSTPAT_INST
+#undef INSTPAT_MATCH
+#define INSTPAT_INST(s) (inst)
+#define INSTPAT_MATCH(s, name, type, ... /* execute body */ ) \
+  format(out, size, str(name), concat(TYPE_, type), pc, inst)
+  INSTPAT_START();
+#include "local-include/inst-list.h"
+  INSTPAT_END();
+}
+
+/* Formatted text of recently disassembled instructions, indexed by pc.
+ * An entry is only reused when the instruction at that pc is unchanged.
+ */
+#define CACHE_SIZE 4096
+static MUXDEF(CONFIG_SMP_THREAD, __thread, ) struct {
+  vaddr_t pc;
+  uint32_t inst;
+  bool valid;
+  char str[48];
+} cache[CACHE_SIZE];
+
+void disassemble(char *str, int size, uint64_t pc, uint8_t *code, int nbyte) {
+  uint32_t inst;
+  memcpy(&inst, code, sizeof(inst));
+  typeof(cache[0]) *e = &cache[(pc >> 2) % CACHE_SIZE];
+  if (!e->valid || e->pc != pc || e->inst != inst) {
+    disasm_inst(e->str, sizeof(e->str), pc, inst);
+    e->pc = pc;
+    e->inst = inst;
+    e->valid = true;
+  }
+  snprintf(str, size, "%s", e->str);
+}
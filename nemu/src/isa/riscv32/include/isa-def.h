@@ -21,6 +21,18 @@
 typedef struct {
   word_t gpr[MUXDEF(CONFIG_RVE, 16, 32)];
   vaddr_t pc;
+  struct {
+    word_t mstatus, mtvec, mepc, mcause, mie, mip, mhartid;
+    word_t mhpmevent[NR_HPM_COUNTER];
+    // a counter reads as its event count minus this offset
+    uint64_t counter_off[NR_COUNTER];
+  } csr;
+#ifdef CONFIG_RVA
+  // reservation set by LR, SC succeeds only if the word still holds `lr_val'
+  bool lr_valid;
+  vaddr_t lr_addr;
+  word_t lr_val;
+#endif
 } MUXDEF(CONFIG_RV64, riscv64_CPU_state, riscv32_CPU_state);
 
 // decode
@@ -32,12 +32,27 @@ static void restart() {
 
   /* The zero register is always 0. */
   cpu.gpr[0] = 0;
+
+  /* Start in M-mode, as the reference design does. */
+  cpu.csr.mstatus = 0x1800;
+}
+
+void isa_hart_init(CPU_state *hart, int id, vaddr_t pc, word_t sp) {
+  memset(hart, 0, sizeof(*hart));
+  hart->pc = pc;
+  hart->gpr[2] = sp;
+  hart->csr.mstatus = 0x1800;
+  hart->csr.mhartid = id;
 }
 
+void init_timing();
+
 void init_isa() {
   /* Load built-in image. */
   memcpy(guest_to_host(RESET_VECTOR), img, sizeof(img));
 
   /* Initialize this virtual computer system. */
   restart();
+
+  IFDEF(CONFIG_TIMING, init_timing());
 }
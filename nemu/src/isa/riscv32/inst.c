@@ -14,27 +14,97 @@
 ***************************************************************************************/
 
 #include "local-include/reg.h"
+#include "local-include/inst.h"
 #include <cpu/cpu.h>
 #include <cpu/ifetch.h>
 #include <cpu/decode.h>
 #include <memory/vaddr.h>
+#include <memory/paddr.h>
 #include <utils.h>
+#include <cpu/inststat.h>
+#include <cpu/coverage.h>
+#include <cpu/pipeline.h>
+#include <cpu/bpred.h>
 #define R(i) gpr(i)
 #define Mr vaddr_read
 #define Mw vaddr_write
 
-enum {
-  TYPE_I, TYPE_U, TYPE_S,
-  TYPE_N, TYPE_R, TYPE_J,
-  TYPE_B// none
-};
 void align(word_t* x) {
   *x = (*x + 3) & ~3;
 }
-void branch(Decode* s, word_t src1, word_t src2, sword_t imm) {
+void branch(Decode* s, bool taken, sword_t imm) {
+  IFDEF(CONFIG_COVERAGE, cov_branch(s->pc, taken));
+  IFDEF(CONFIG_BPRED, bpred_cond(s->pc, taken, s->pc + (sword_t)imm * 2));
+  if (!taken) {
+    pipe_put(PIPE_BRANCH, s->pc, s->snpc, 0, false);
+    return;
+  }
+  hpm_count(HPM_EV_BRANCH);
   s->dnpc = s->pc + (sword_t)imm * 2; 
-  Log("imm is %x", imm);
+  pipe_put(PIPE_BRANCH, s->pc, s->dnpc, 0, true);
+  Debug(LOG_ISA, "imm is %x", imm);
+}
+#ifdef CONFIG_FTRACE
+#include <cpu/ftrace.h>
+// calls link to ra, and `ret' is `jalr x0, 0(ra)'
+static void ftrace_jump(Decode *s, int rd) {
+  int rs1 = BITS(s->isa.inst, 19, 15);
+  if (rd == 1) ftrace_call(s->pc, s->dnpc, s->snpc);
+  else if (rd == 0 && rs1 == 1 && BITS(s->isa.inst, 6, 0) == 0x67) ftrace_ret(s->pc, s->dnpc);
+}
+#endif
+#ifdef CONFIG_BPRED
+// ra and t0 are link registers, following the hints for return address prediction in the spec
+#define is_link(r) ((r) == 1 || (r) == 5)
+static void bpred_jal(Decode *s, int rd) {
+  int rs1 = BITS(s->isa.inst, 19, 15);
+  bool is_jalr = (BITS(s->isa.inst, 6, 0) == 0x67);
+  int kind = (is_link(rd) ? BP_CALL : is_jalr && is_link(rs1) ? BP_RET : BP_JUMP);
+  bpred_jump(s->pc, kind, s->dnpc, s->snpc);
+}
+#endif
+enum { CSR_RW, CSR_RS, CSR_RC };
+// `src' is either R(rs1) or the zero-extended rs1 field for csr*i
+static word_t csr_op(uint32_t inst, word_t src, int op) {
+  int no = BITS(inst, 31, 20);
+  bool is_write = (op == CSR_RW || BITS(inst, 19, 15) != 0);
+  word_t old = csr_read(no);
+  if (is_write) csr_write(no, (op == CSR_RW ? src : op == CSR_RS ? old | src : old & ~src));
+  return old;
+}
+
+static vaddr_t mret() {
+  // MIE <- MPIE, MPIE <- 1
+  word_t mstatus = cpu.csr.mstatus;
+  mstatus = (mstatus & MSTATUS_MPIE ? mstatus | MSTATUS_MIE : mstatus & ~MSTATUS_MIE);
+  cpu.csr.mstatus = mstatus | MSTATUS_MPIE;
+  return cpu.csr.mepc;
+}
+
+#ifdef CONFIG_RVA
+// LR/SC and AMOs only work on aligned words in pmem, others raise exceptions
+static bool amo_check(Decode *s, vaddr_t addr, bool is_lr) {
+  if (addr & 3) s->dnpc = isa_raise_intr(is_lr ? EXC_LOAD_MISALIGNED : EXC_AMO_MISALIGNED, s->pc);
+  else if (!in_pmem(addr)) s->dnpc = isa_raise_intr(is_lr ? EXC_LOAD_FAULT : EXC_AMO_FAULT, s->pc);
+  else return true;
+  return false;
+}
+#define AMO(op) if (amo_check(s, src1, false)) R(rd) = vaddr_amo(src1, 4, op, src2)
+
+static word_t load_reserved(vaddr_t addr) {
+  cpu.lr_valid = true;
+  cpu.lr_addr = addr;
+  cpu.lr_val = Mr(addr, 4);
+  return cpu.lr_val;
+}
+
+// return 0 on success, just like the value written to rd
+static word_t store_conditional(vaddr_t addr, word_t data) {
+  bool ok = cpu.lr_valid && cpu.lr_addr == addr && vaddr_cas(addr, 4, cpu.lr_val, data);
+  cpu.lr_valid = false;
+  return !ok;
 }
+#endif
 // set the immidate through macro definition
 // all the influence to the registers are done there
 #define src1R() do { *src1 = R(rs1); } while (0)
@@ -64,9 +134,8 @@ static void decode_operand(Decode *s, int *rd, word_t *src1, word_t *src2, word_
     /*J-type指令操作仅由7位opcode决定，与U-type一样只有一个目的寄存器rd和20位的立即数，但是立即数的位域
     与U-type的组成不同，J-type一般用于无条件跳转，如jal指令，RV32I一共有1条J-type指令。*/
     case TYPE_J: immJ();                    break;
-    case TYPE_N: 
-      Warn("Not impl instruction at %x", s->pc);
-    break;
+    // no operands, and invalid instructions are reported by INV()
+    case TYPE_N:                            break;
     default: 
     panic("unsupported type = %d", type);
   }
@@ -74,13 +143,14 @@ static void decode_operand(Decode *s, int *rd, word_t *src1, word_t *src2, word_
 
 static int decode_exec(Decode *s) {
   s->dnpc = s->snpc;
-  Log("Decoding pc = %x", s->pc);
+  Debug(LOG_ISA, "Decoding pc = %x", s->pc);
 #define INSTPAT_INST(s) ((s)->isa.inst)
 #define INSTPAT_MATCH(s, name, type, ... /* execute body */ ) { \
   int rd = 0; \
   word_t src1 = 0, src2 = 0, imm = 0; \
   decode_operand(s, &rd, &src1, &src2, &imm, concat(TYPE_, type)); \
-  __VA_ARGS__ ; \
+  IFDEF(CONFIG_INST_STAT, inst_stat_pattern(str(name))); \
+  hprof_phase(HP_EXEC, __VA_ARGS__); \
 }
   INSTPAT_START();
   //INSTPAT(模式字符串, 指令名称, 指令类型, 指令执行操作);
@@ -104,79 +174,35 @@ static int decode_exec(Decode *s) {
 
   // given U type instructions, no need to have more of them in rv32i
   
-  INSTPAT("??????? ????? ????? ??? ????? 00101 11", auipc  , U, R(rd) = s->pc + imm);
-  INSTPAT("??????? ????? ????? ??? ????? 01101 11", lui    , U, R(rd) = imm << 12);
-
-  INSTPAT("??????? ????? ????? 000 ????? 01000 11", sb     , S, Mw(src1 + imm, 1, src2));
-  // my instructions
-
-  
-  // my R instructions
-  INSTPAT("0000000 ????? ????? 000 ????? 01100 11", add    , R, R(rd) = src1 + src2);
-  INSTPAT("0100000 ????? ????? 000 ????? 01100 11", sub    , R, R(rd) = src1 - src2);
-  INSTPAT("0000000 ????? ????? 100 ????? 01100 11", xor    , R, R(rd) = src1 ^ src2);
-  INSTPAT("0000000 ????? ????? 110 ????? 01100 11", or     , R, R(rd) = src1 | src2);
-  INSTPAT("0000000 ????? ????? 111 ????? 01100 11", and    , R, R(rd) = src1 & src2);
-  INSTPAT("0000000 ????? ????? 001 ????? 01100 11", sll    , R, R(rd) = src1 << src2);
-  INSTPAT("0000000 ????? ????? 101 ????? 01100 11", srl    , R, R(rd) = ((word_t)src1) >> src2);
-  INSTPAT("0100000 ????? ????? 001 ????? 01100 11", sra    , R, R(rd) = ((sword_t)src1) >> src2);
-  INSTPAT("0000000 ????? ????? 010 ????? 01100 11", slt    , R, if((sword_t)src1 < (sword_t)src2) R(rd) = 1; else R(rd) = 0);
-  INSTPAT("0000000 ????? ????? 011 ????? 01100 11", sltu   , R, if((word_t)src1 < (word_t)src2) R(rd) = 1; else R(rd) = 0);
-  
-  INSTPAT("??????? ????? ????? 100 ????? 00000 11", lbu    , I, R(rd) = Mr(src1 + imm, 1));
-  // my I instructions
-  // bit-wise add does not differentiate between signed and unsigned
-  // INSTPAT("??????? ????? ????? 000 ????? 00100 11", addi   , I, R(rd) = src1 + imm);
-  INSTPAT("?????? ?????? ????? 000 ????? 00100 11", addi   , I, R(rd) = src1 + imm);
-  INSTPAT("?????? ?????? ????? 100 ????? 00100 11", xori   , I, R(rd) = src1 ^ (sword_t)imm);
-  INSTPAT("?????? ?????? ????? 110 ????? 00100 11", ori    , I, R(rd) = src1 | (sword_t)imm);
-  INSTPAT("?????? ?????? ????? 111 ????? 00100 11", andi   , I, R(rd) = src1 & (sword_t)imm);
-  INSTPAT("000000 ?????? ????? 001 ????? 00100 11", slli   , I, R(rd) = src1 << imm);
-  INSTPAT("000000 ?????? ????? 101 ????? 00100 11", srli   , I, R(rd) = ((word_t)src1) >> imm);
-  INSTPAT("010000 ?????? ????? 101 ????? 00100 11", srai   , I, R(rd) = ((sword_t)src1) << imm);
-
-  INSTPAT("?????? ?????? ????? 010 ????? 00100 11", slti   , I, if((sword_t)src1 < (sword_t)imm) R(rd) = 1; else R(rd) = 0);
-  INSTPAT("?????? ?????? ????? 011 ????? 00100 11", sltiu  , I, if((word_t)src1 < (word_t)imm) R(rd) = 1; else R(rd) = 0);
-  // load one byte
-  INSTPAT("?????? ?????? ????? 000 ????? 00000 11", lb     , I, R(rd) = SEXT(vaddr_ifetch(src1 + (sword_t)imm, 1), 8));
-  INSTPAT("?????? ?????? ????? 001 ????? 00000 11", lh     , I, R(rd) = SEXT(vaddr_ifetch(src1 + (sword_t)imm, 2), 16));
-  // 1 word is equals to 4 bytes
-  INSTPAT("?????? ?????? ????? 010 ????? 00000 11", lw     , I, R(rd) = vaddr_ifetch(src1 + (sword_t)imm, 4));
-  INSTPAT("?????? ?????? ????? 100 ????? 00000 11", lbu    , I, R(rd) = vaddr_ifetch(src1 + (sword_t)imm, 1));
-
-  INSTPAT("?????? ?????? ????? 101 ????? 00000 11", lhu    , I, R(rd) = vaddr_ifetch(src1 + (sword_t)imm, 2));
-  INSTPAT("?????? ?????? ????? 000 ????? 11001 11", jalr   , I, R(rd) = s->pc; s->dnpc = src1 + (sword_t)imm);
-  INSTPAT("000000 000000 00000 000 00000 11100 11", ecall  , I, panic("ecall not implemented"));
-
-  // my S series
-  INSTPAT("?????? ?????? ????? 000 ????? 01000 11", sb     , S, vaddr_write(src1 + (sword_t)imm, 1, (word_t)src2));
-  INSTPAT("?????? ?????? ????? 001 ????? 01000 11", sh     , S, vaddr_write(src1 + (sword_t)imm, 2, (word_t)src2));
-  INSTPAT("?????? ?????? ????? 010 ????? 01000 11", sw     , S, vaddr_write(src1 + (sword_t)imm, 4, (word_t)src2));
-  // my B series
-  INSTPAT("?????? ?????? ????? 000 ????? 11000 11", beq    , B, if (src1 == src2) branch(s, src1, src2, ((sword_t)imm)););
-  INSTPAT("?????? ?????? ????? 001 ????? 11000 11", bne    , B, if (src1 != src2) branch(s, src1, src2, ((sword_t)imm)););
-  // attention: the 0 bit of imm is not specified cause we neet to << 1 to imm
-  // thus imm[0] === 0
-  INSTPAT("?????? ?????? ????? 100 ????? 11000 11", blt    , B, if (((sword_t)src1) < ((sword_t)src2)) branch(s, src1, src2, ((sword_t)imm)););
-  INSTPAT("?????? ?????? ????? 101 ????? 11000 11", bge    , B, if (((sword_t)src1) >= ((sword_t)src2)) branch(s, src1, src2, ((sword_t)imm)););
-  INSTPAT("?????? ?????? ????? 110 ????? 11000 11", bltu   , B, if (((word_t)src1) < ((word_t)src2)) branch(s, src1, src2, ((sword_t)imm)););
-  INSTPAT("?????? ?????? ????? 111 ????? 11000 11", bgeu   , B, if (((word_t)src1) >= ((word_t)src2)) branch(s, src1, src2, ((sword_t)imm)););
-  // my J series
-  INSTPAT("?????? ?????? ????? ??? ????? 11011 11", jal    , J, R(rd) = s->snpc; branch(s, src1, src2, ((sword_t)imm)););
-  INSTPAT("0000000 00001 00000 000 00000 11100 11", ebreak , N, NEMUTRAP(s->pc, R(10))); // R(10) is $a0
-  INSTPAT("??????? ????? ????? ??? ????? ????? ??", inv    , N, INV(s->pc));
+#include "local-include/inst-list.h"
   INSTPAT_END();
 
   R(0) = 0; // reset $zero to 0
   // align(&s->dnpc);
-  Log("snpc: %x, dnpc:%x", s->snpc, s->dnpc);
+  Debug(LOG_ISA, "snpc: %x, dnpc:%x", s->snpc, s->dnpc);
   return 0;
 }
 
+void timing_inst(Decode *s);
+
 int isa_exec_once(Decode *s) {
   // in inst fetch, pc is incremented by 4(rv32)
-  s->isa.inst = inst_fetch(&s->snpc, 4);
+  hprof_phase(HP_FETCH, s->isa.inst = inst_fetch(&s->snpc, 4));
   // decode exec receives the pc of the next instruction
   // so do not increment pc in decode_exec
-  return decode_exec(s);
+  int ret;
+  hprof_phase(HP_DECODE, ret = decode_exec(s));
+  IFDEF(CONFIG_TIMING, timing_inst(s));
+  return ret;
+}
+
+#ifdef CONFIG_ITRACE_BIN_RD
+bool isa_itrace_rd(Decode *s, word_t *val) {
+  uint32_t opcode = BITS(s->isa.inst, 6, 0);
+  int rd = BITS(s->isa.inst, 11, 7);
+  // stores and branches have no rd
+  if (rd == 0 || opcode == 0x23 || opcode == 0x63) return false;
+  *val = R(rd);
+  return true;
 }
+#endif
@@ -0,0 +1,104 @@
+/***************************************************************************************
+* Copyright (c) 2014-2024 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+// The instruction table shared by decode_exec() and the disassembler.
+// It is included between INSTPAT_START() and INSTPAT_END(), so there is
+// no include guard. The disassembler never expands the execute bodies.
+
+  INSTPAT("??????? ????? ????? ??? ????? 00101 11", auipc  , U, R(rd) = s->pc + imm);
+  INSTPAT("??????? ????? ????? ??? ????? 01101 11", lui    , U, R(rd) = imm << 12);
+
+  INSTPAT("??????? ????? ????? 000 ????? 01000 11", sb     , S, Mw(src1 + imm, 1, src2));
+  // my instructions
+
+  
+  // my R instructions
+  INSTPAT("0000000 ????? ????? 000 ????? 01100 11", add    , R, R(rd) = src1 + src2);
+  INSTPAT("0100000 ????? ????? 000 ????? 01100 11", sub    , R, R(rd) = src1 - src2);
+  INSTPAT("0000000 ????? ????? 100 ????? 01100 11", xor    , R, R(rd) = src1 ^ src2);
+  INSTPAT("0000000 ????? ????? 110 ????? 01100 11", or     , R, R(rd) = src1 | src2);
+  INSTPAT("0000000 ????? ????? 111 ????? 01100 11", and    , R, R(rd) = src1 & src2);
+  INSTPAT("0000000 ????? ????? 001 ????? 01100 11", sll    , R, R(rd) = src1 << src2);
+  INSTPAT("0000000 ????? ????? 101 ????? 01100 11", srl    , R, R(rd) = ((word_t)src1) >> src2);
+  INSTPAT("0100000 ????? ????? 001 ????? 01100 11", sra    , R, R(rd) = ((sword_t)src1) >> src2);
+  INSTPAT("0000000 ????? ????? 010 ????? 01100 11", slt    , R, if((sword_t)src1 < (sword_t)src2) R(rd) = 1; else R(rd) = 0);
+  INSTPAT("0000000 ????? ????? 011 ????? 01100 11", sltu   , R, if((word_t)src1 < (word_t)src2) R(rd) = 1; else R(rd) = 0);
+  
+  INSTPAT("??????? ????? ????? 100 ????? 00000 11", lbu    , I, R(rd) = Mr(src1 + imm, 1));
+  // my I instructions
+  // bit-wise add does not differentiate between signed and unsigned
+  // INSTPAT("??????? ????? ????? 000 ????? 00100 11", addi   , I, R(rd) = src1 + imm);
+  INSTPAT("?????? ?????? ????? 000 ????? 00100 11", addi   , I, R(rd) = src1 + imm);
+  INSTPAT("?????? ?????? ????? 100 ????? 00100 11", xori   , I, R(rd) = src1 ^ (sword_t)imm);
+  INSTPAT("?????? ?????? ????? 110 ????? 00100 11", ori    , I, R(rd) = src1 | (sword_t)imm);
+  INSTPAT("?????? ?????? ????? 111 ????? 00100 11", andi   , I, R(rd) = src1 & (sword_t)imm);
+  INSTPAT("000000 ?????? ????? 001 ????? 00100 11", slli   , I, R(rd) = src1 << imm);
+  INSTPAT("000000 ?????? ????? 101 ????? 00100 11", srli   , I, R(rd) = ((word_t)src1) >> imm);
+  INSTPAT("010000 ?????? ????? 101 ????? 00100 11", srai   , I, R(rd) = ((sword_t)src1) << imm);
+
+  INSTPAT("?????? ?????? ????? 010 ????? 00100 11", slti   , I, if((sword_t)src1 < (sword_t)imm) R(rd) = 1; else R(rd) = 0);
+  INSTPAT("?????? ?????? ????? 011 ????? 00100 11", sltiu  , I, if((word_t)src1 < (word_t)imm) R(rd) = 1; else R(rd) = 0);
+  // load one byte
+  INSTPAT("?????? ?????? ????? 000 ????? 00000 11", lb     , I, R(rd) = SEXT(Mr(src1 + (sword_t)imm, 1), 8));
+  INSTPAT("?????? ?????? ????? 001 ????? 00000 11", lh     , I, R(rd) = SEXT(Mr(src1 + (sword_t)imm, 2), 16));
+  // 1 word is equals to 4 bytes
+  INSTPAT("?????? ?????? ????? 010 ????? 00000 11", lw     , I, R(rd) = Mr(src1 + (sword_t)imm, 4));
+  INSTPAT("?????? ?????? ????? 100 ????? 00000 11", lbu    , I, R(rd) = Mr(src1 + (sword_t)imm, 1));
+
+  INSTPAT("?????? ?????? ????? 101 ????? 00000 11", lhu    , I, R(rd) = Mr(src1 + (sword_t)imm, 2));
+  INSTPAT("?????? ?????? ????? 000 ????? 11001 11", jalr   , I, R(rd) = s->pc; s->dnpc = src1 + (sword_t)imm; IFDEF(CONFIG_FTRACE, ftrace_jump(s, rd)); IFDEF(CONFIG_BPRED, bpred_jal(s, rd)));
+  INSTPAT("000000 000000 00000 000 00000 11100 11", ecall  , I, s->dnpc = isa_raise_intr(EXC_ECALL_M, s->pc));
+
+  // my S series
+  INSTPAT("?????? ?????? ????? 000 ????? 01000 11", sb     , S, vaddr_write(src1 + (sword_t)imm, 1, (word_t)src2));
+  INSTPAT("?????? ?????? ????? 001 ????? 01000 11", sh     , S, vaddr_write(src1 + (sword_t)imm, 2, (word_t)src2));
+  INSTPAT("?????? ?????? ????? 010 ????? 01000 11", sw     , S, vaddr_write(src1 + (sword_t)imm, 4, (word_t)src2));
+  // my B series
+  INSTPAT("?????? ?????? ????? 000 ????? 11000 11", beq    , B, branch(s, src1 == src2, (sword_t)imm));
+  INSTPAT("?????? ?????? ????? 001 ????? 11000 11", bne    , B, branch(s, src1 != src2, (sword_t)imm));
+  // attention: the 0 bit of imm is not specified cause we neet to << 1 to imm
+  // thus imm[0] === 0
+  INSTPAT("?????? ?????? ????? 100 ????? 11000 11", blt    , B, branch(s, (sword_t)src1 < (sword_t)src2, (sword_t)imm));
+  INSTPAT("?????? ?????? ????? 101 ????? 11000 11", bge    , B, branch(s, (sword_t)src1 >= (sword_t)src2, (sword_t)imm));
+  INSTPAT("?????? ?????? ????? 110 ????? 11000 11", bltu   , B, branch(s, src1 < src2, (sword_t)imm));
+  INSTPAT("?????? ?????? ????? 111 ????? 11000 11", bgeu   , B, branch(s, src1 >= src2, (sword_t)imm));
+  // my J series
+  INSTPAT("?????? ?????? ????? ??? ????? 11011 11", jal    , J, R(rd) = s->snpc; s->dnpc = s->pc + (sword_t)imm * 2; IFDEF(CONFIG_FTRACE, ftrace_jump(s, rd)); IFDEF(CONFIG_BPRED, bpred_jal(s, rd)));
+#ifdef CONFIG_RVA
+  // A extension, aq/rl are ignored since every AMO is sequentially consistent
+  INSTPAT("00010?? 00000 ????? 010 ????? 01011 11", lr.w     , R, if (amo_check(s, src1, true)) R(rd) = load_reserved(src1));
+  INSTPAT("00011?? ????? ????? 010 ????? 01011 11", sc.w     , R, if (amo_check(s, src1, false)) R(rd) = store_conditional(src1, src2));
+  INSTPAT("00001?? ????? ????? 010 ????? 01011 11", amoswap.w, R, AMO(AMO_SWAP));
+  INSTPAT("00000?? ????? ????? 010 ????? 01011 11", amoadd.w , R, AMO(AMO_ADD));
+  INSTPAT("00100?? ????? ????? 010 ????? 01011 11", amoxor.w , R, AMO(AMO_XOR));
+  INSTPAT("01100?? ????? ????? 010 ????? 01011 11", amoand.w , R, AMO(AMO_AND));
+  INSTPAT("01000?? ????? ????? 010 ????? 01011 11", amoor.w  , R, AMO(AMO_OR));
+  INSTPAT("10000?? ????? ????? 010 ????? 01011 11", amomin.w , R, AMO(AMO_MIN));
+  INSTPAT("10100?? ????? ????? 010 ????? 01011 11", amomax.w , R, AMO(AMO_MAX));
+  INSTPAT("11000?? ????? ????? 010 ????? 01011 11", amominu.w, R, AMO(AMO_MINU));
+  INSTPAT("11100?? ????? ????? 010 ????? 01011 11", amomaxu.w, R, AMO(AMO_MAXU));
+#endif
+  // Zicsr and privileged instructions
+  INSTPAT("??????? ????? ????? 001 ????? 11100 11", csrrw  , I, R(rd) = csr_op(s->isa.inst, src1, CSR_RW));
+  INSTPAT("??????? ????? ????? 010 ????? 11100 11", csrrs  , I, R(rd) = csr_op(s->isa.inst, src1, CSR_RS));
+  INSTPAT("??????? ????? ????? 011 ????? 11100 11", csrrc  , I, R(rd) = csr_op(s->isa.inst, src1, CSR_RC));
+  INSTPAT("??????? ????? ????? 101 ????? 11100 11", csrrwi , I, R(rd) = csr_op(s->isa.inst, BITS(s->isa.inst, 19, 15), CSR_RW));
+  INSTPAT("??????? ????? ????? 110 ????? 11100 11", csrrsi , I, R(rd) = csr_op(s->isa.inst, BITS(s->isa.inst, 19, 15), CSR_RS));
+  INSTPAT("??????? ????? ????? 111 ????? 11100 11", csrrci , I, R(rd) = csr_op(s->isa.inst, BITS(s->isa.inst, 19, 15), CSR_RC));
+  INSTPAT("0011000 00010 00000 000 00000 11100 11", mret   , N, s->dnpc = mret());
+  // interrupts are only checked at block boundaries, so wfi can be a nop
+  INSTPAT("0001000 00101 00000 000 00000 11100 11", wfi    , N, );
+  INSTPAT("0000000 00001 00000 000 00000 11100 11", ebreak , N, NEMUTRAP(s->pc, R(10))); // R(10) is $a0
+  INSTPAT("??????? ????? ????? ??? ????? ????? ??", inv    , N, INV(s->pc));
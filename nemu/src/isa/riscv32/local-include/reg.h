@@ -30,4 +30,34 @@ static inline const char* reg_name(int idx) {
   return regs[check_reg_idx(idx)];
 }
 
+enum {
+  CSR_MSTATUS = 0x300, CSR_MIE = 0x304, CSR_MTVEC = 0x305,
+  CSR_MEPC = 0x341, CSR_MCAUSE = 0x342, CSR_MIP = 0x344,
+  CSR_MHARTID = 0xf14,
+  CSR_MHPMEVENT3 = 0x323,
+  // counters, the high halves are at +0x80
+  CSR_MCYCLE = 0xb00, CSR_MINSTRET = 0xb02, CSR_MHPMCOUNTER3 = 0xb03,
+  CSR_CYCLE = 0xc00, CSR_TIME = 0xc01, CSR_INSTRET = 0xc02, CSR_HPMCOUNTER3 = 0xc03,
+};
+
+// cycle, time, instret and hpmcounter3-6
+#define NR_HPM_COUNTER 4
+#define NR_COUNTER (3 + NR_HPM_COUNTER)
+
+#define MSTATUS_MIE  (1 << 3)
+#define MSTATUS_MPIE (1 << 7)
+#define MSTATUS_MPP  (3 << 11)
+#define MIP_MTIP     (1 << 7)
+
+#define INTR_BIT     ((word_t)1 << (sizeof(word_t) * 8 - 1))
+#define IRQ_TIMER    (INTR_BIT | 7)
+#define EXC_LOAD_MISALIGNED 4
+#define EXC_LOAD_FAULT      5
+#define EXC_AMO_MISALIGNED  6 // also for stores
+#define EXC_AMO_FAULT       7
+#define EXC_ECALL_M         11
+
+word_t csr_read(int no);
+void csr_write(int no, word_t val);
+
 #endif
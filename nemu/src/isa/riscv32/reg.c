@@ -14,6 +14,9 @@
 ***************************************************************************************/
 
 #include <isa.h>
+#include <cpu/cpu.h>
+#include <cpu/timing.h>
+#include <cpu/reverse.h>
 #include "local-include/reg.h"
 
 const char *regs[] = {
@@ -23,6 +26,96 @@ const char *regs[] = {
   "s8", "s9", "s10", "s11", "t3", "t4", "t5", "t6"
 };
 
+// NULL for the CSRs NEMU does not model, which read as zero and ignore writes
+static word_t *csr_ptr(int no) {
+  switch (no) {
+    case CSR_MSTATUS: return &cpu.csr.mstatus;
+    case CSR_MIE:     return &cpu.csr.mie;
+    case CSR_MTVEC:   return &cpu.csr.mtvec;
+    case CSR_MEPC:    return &cpu.csr.mepc;
+    case CSR_MCAUSE:  return &cpu.csr.mcause;
+    case CSR_MIP:     return &cpu.csr.mip;
+    case CSR_MHARTID: return &cpu.csr.mhartid;
+    default:
+      Debug(LOG_ISA, "unsupported CSR 0x%03x at pc = " FMT_WORD, no, cpu.pc);
+      return NULL;
+  }
+}
+
+// index of the counter accessed by CSR `no', or -1 if it is not a counter
+static int counter_idx(int no, bool *hi) {
+  int idx = no & 0x1f;
+  *hi = (no & 0x80) != 0;
+  if (MUXDEF(CONFIG_RV64, *hi, false) || idx >= NR_COUNTER) return -1;
+  switch (no & ~0x9f) {
+    case CSR_MCYCLE: return (idx == 1 ? -1 : idx); // there is no mtime CSR
+    case CSR_CYCLE:  return idx;
+    default: return -1;
+  }
+}
+
+/* The counters are never updated by the exec loop. They are computed from
+ * the counts NEMU keeps anyway when they are read. Without a timing model,
+ * every instruction takes one cycle.
+ */
+static uint64_t counter_event_raw(int idx) {
+  switch (idx) {
+    case 0: return MUXDEF(CONFIG_TIMING, timing_cycles(), cpu_instret());
+    case 2: return cpu_instret();
+    case 1: return get_time();
+    default: {
+      word_t ev = cpu.csr.mhpmevent[idx - 3];
+      return (ev >= 1 && ev <= NR_HPM_EV ? cpu_hpm_event(ev - 1) : 0);
+    }
+  }
+}
+
+// the counts are not restored by reverse execution, so they are recorded and replayed
+static uint64_t counter_event(int idx) {
+  return MUXDEF(CONFIG_REVERSE, rev_input(counter_event_raw(idx)), counter_event_raw(idx));
+}
+
+static uint64_t counter_read(int idx) {
+  return counter_event(idx) - cpu.csr.counter_off[idx];
+}
+
+word_t csr_read(int no) {
+  bool hi;
+  int idx = counter_idx(no, &hi);
+  if (idx >= 0) return (hi ? counter_read(idx) >> 32 : counter_read(idx));
+  if (no >= CSR_MHPMEVENT3 && no < CSR_MHPMEVENT3 + NR_HPM_COUNTER) {
+    return cpu.csr.mhpmevent[no - CSR_MHPMEVENT3];
+  }
+  word_t *p = csr_ptr(no);
+  return (p ? *p : 0);
+}
+
+void csr_write(int no, word_t val) {
+  if (no == CSR_MHARTID) return; // read-only
+  bool hi;
+  int idx = counter_idx(no, &hi);
+  if (idx >= 0) {
+    // the user-level counters and time are read-only
+    if ((no & ~0x9f) == CSR_CYCLE) return;
+    uint64_t old = counter_read(idx), new_val = val;
+    if (sizeof(word_t) < sizeof(uint64_t)) {
+      new_val = (hi ? (old & 0xffffffffu) | ((uint64_t)val << 32) : (old & ~0xffffffffull) | val);
+    }
+    cpu.csr.counter_off[idx] = counter_event(idx) - new_val;
+    return;
+  }
+  if (no >= CSR_MHPMEVENT3 && no < CSR_MHPMEVENT3 + NR_HPM_COUNTER) {
+    // keep the value of the counter when switching its event
+    int i = 3 + no - CSR_MHPMEVENT3;
+    uint64_t old = counter_read(i);
+    cpu.csr.mhpmevent[no - CSR_MHPMEVENT3] = val;
+    cpu.csr.counter_off[i] = counter_event(i) - old;
+    return;
+  }
+  word_t *p = csr_ptr(no);
+  if (p) *p = val;
+}
+
 void isa_reg_display() {
   Log("Registers:");
   int ct = 0;
@@ -33,15 +126,23 @@ void isa_reg_display() {
     if (ct % 4 == 0) printf("\n");
     else printf("\t");
   }
+  printf("mstatus 0x%08x\tmtvec 0x%08x\tmepc 0x%08x\tmcause 0x%08x\n",
+      cpu.csr.mstatus, cpu.csr.mtvec, cpu.csr.mepc, cpu.csr.mcause);
 }
 
-word_t isa_reg_str2val(const char *s, bool *success) {
-  Log("reg_str2val %s", s);
+word_t *isa_reg_ptr(const char *s) {
+  // tokens of sdb keep the leading '$', e.g. "$a0", "$pc", "$$0"
+  if (s[0] == '$') s ++;
+  if (strcmp(s, "pc") == 0) return &cpu.pc;
   for (word_t i = 0; i < sizeof(regs) / sizeof(regs[0]); i++){
-    if (strcmp(s, regs[i]) == 0){
-      *success = true;
-        return cpu.gpr[i];
-      }
-    }
-  return 0;
+    if (strcmp(s, regs[i]) == 0) return &cpu.gpr[i];
+  }
+  return NULL;
+}
+
+word_t isa_reg_str2val(const char *s, bool *success) {
+  Debug(LOG_ISA, "reg_str2val %s", s);
+  word_t *reg = isa_reg_ptr(s);
+  *success = (reg != NULL);
+  return (reg ? *reg : 0);
 }
@@ -14,15 +14,28 @@
 ***************************************************************************************/
 
 #include <isa.h>
+#include <cpu/cpu.h>
+#include <cpu/plugin.h>
+#include "../local-include/reg.h"
 
 word_t isa_raise_intr(word_t NO, vaddr_t epc) {
-  /* TODO: Trigger an interrupt/exception with ``NO''.
-   * Then return the address of the interrupt/exception vector.
-   */
-
-  return 0;
+  plugin_event(PLUGIN_EV_TRAP, plugin_trap(epc, NO));
+  word_t mstatus = cpu.csr.mstatus;
+  cpu.csr.mepc = epc;
+  cpu.csr.mcause = NO;
+  // MPIE <- MIE, MIE <- 0, MPP <- M
+  mstatus = (mstatus & MSTATUS_MIE ? mstatus | MSTATUS_MPIE : mstatus & ~MSTATUS_MPIE);
+  cpu.csr.mstatus = (mstatus & ~MSTATUS_MIE) | MSTATUS_MPP;
+  return cpu.csr.mtvec;
 }
 
 word_t isa_query_intr() {
+  uint32_t lines = cpu_fetch_intr();
+  if (unlikely(lines & (1u << INTR_LINE_TIMER))) cpu.csr.mip |= MIP_MTIP;
+
+  if ((cpu.csr.mstatus & MSTATUS_MIE) && (cpu.csr.mip & cpu.csr.mie & MIP_MTIP)) {
+    cpu.csr.mip &= ~MIP_MTIP;
+    return IRQ_TIMER;
+  }
   return INTR_EMPTY;
 }
@@ -0,0 +1,129 @@
+/***************************************************************************************
+* Copyright (c) 2014-2024 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#include <cpu/decode.h>
+#include <cpu/timing.h>
+#include <cpu/bpred.h>
+#include <cpu/ftrace.h>
+
+/* A single-issue in-order pipeline. Every instruction takes one cycle,
+ * except multiplications and divisions, which block the pipeline for
+ * their latency. An instruction using the result of the load right before
+ * it waits for the load-use penalty. Taken control transfers redirect the
+ * fetch, unless a branch predictor is selected with --bpred, in which
+ * case only mispredictions do.
+ */
+#define TIMING_NR_PC (CONFIG_MSIZE >> 2)
+
+uint64_t timing_stall = 0;
+static uint64_t cycle = 0;
+static int load_rd = 0; // rd of the previous instruction if it is a load, or 0
+
+// cycles and instructions of each pc in the physical memory, for the report
+static uint64_t *pc_cycle = NULL, *pc_inst = NULL;
+
+void timing_inst(Decode *s) {
+  uint32_t i = s->isa.inst;
+  int rd = BITS(i, 11, 7), rs1 = BITS(i, 19, 15), rs2 = BITS(i, 24, 20);
+  bool use_rs1 = true, use_rs2 = false, is_jump = false;
+  int next_load_rd = 0;
+  uint64_t c = 1;
+  switch (BITS(i, 6, 0)) {
+    case 0x33: // OP, including M extension
+      use_rs2 = true;
+      if (BITS(i, 31, 25) == 1) {
+        c = (BITS(i, 14, 12) & 0x4 ? CONFIG_TIMING_DIV_LATENCY : CONFIG_TIMING_MUL_LATENCY);
+      }
+      break;
+    case 0x2f: // AMO
+      use_rs2 = true;
+      c = 2;
+      // fall through
+    case 0x03: next_load_rd = rd; break; // LOAD
+    case 0x23: use_rs2 = true; break;    // STORE
+    case 0x63: use_rs2 = true; is_jump = true; break; // BRANCH
+    case 0x67: is_jump = true; break;    // JALR
+    case 0x6f: use_rs1 = false; is_jump = true; break; // JAL
+    case 0x37: case 0x17: use_rs1 = false; break; // LUI, AUIPC
+  }
+
+  if (load_rd != 0 && ((use_rs1 && rs1 == load_rd) || (use_rs2 && rs2 == load_rd))) {
+    c += CONFIG_TIMING_LOAD_USE_PENALTY;
+  }
+  load_rd = next_load_rd;
+  if (is_jump && s->dnpc != s->snpc && MUXDEF(CONFIG_BPRED, bpred_model == BP_OFF, true)) {
+    c += CONFIG_TIMING_BRANCH_PENALTY;
+  }
+
+  c += timing_stall;
+  timing_stall = 0;
+  cycle += c;
+  word_t idx = (s->pc - CONFIG_MBASE) >> 2;
+  if (idx < TIMING_NR_PC) {
+    pc_cycle[idx] += c;
+    pc_inst[idx] ++;
+  }
+}
+
+uint64_t timing_cycles() {
+  return cycle;
+}
+
+void init_timing() {
+  // only the pages of executed code are touched
+  pc_cycle = calloc(TIMING_NR_PC, sizeof(uint64_t));
+  pc_inst = calloc(TIMING_NR_PC, sizeof(uint64_t));
+  assert(pc_cycle && pc_inst);
+}
+
+typedef struct {
+  const char *name;
+  uint64_t cycle, inst;
+} FuncTime;
+
+static int func_cmp(const void *a, const void *b) {
+  uint64_t x = ((FuncTime *)a)->cycle, y = ((FuncTime *)b)->cycle;
+  return (x < y) - (x > y);
+}
+
+void timing_report() {
+  extern uint64_t g_nr_guest_inst;
+  Log("estimated cycles = %" PRIu64 ", IPC = %.3f", cycle,
+      cycle ? (double)g_nr_guest_inst / cycle : 0);
+
+  int nr = elf_nr_sym();
+  if (nr == 0) return;
+  FuncTime *f = malloc(sizeof(FuncTime) * nr);
+  assert(f);
+  int n = 0;
+  for (int k = 0; k < nr; k ++) {
+    const ElfSym *sym = elf_sym(k);
+    FuncTime t = { .name = sym->name };
+    for (vaddr_t pc = sym->start; pc < sym->end; pc += 4) {
+      word_t idx = (pc - CONFIG_MBASE) >> 2;
+      if (idx >= TIMING_NR_PC) break;
+      t.cycle += pc_cycle[idx];
+      t.inst += pc_inst[idx];
+    }
+    if (t.cycle != 0) f[n ++] = t;
+  }
+  qsort(f, n, sizeof(FuncTime), func_cmp);
+  if (n > 0) Log("cycles per function:");
+  for (int k = 0; k < n && k < CONFIG_TIMING_TOP; k ++) {
+    Log("  %-24s %14" PRIu64 " %6.2f%%  IPC = %.3f", f[k].name, f[k].cycle,
+        100.0 * f[k].cycle / cycle, (double)f[k].inst / f[k].cycle);
+  }
+  free(f);
+}
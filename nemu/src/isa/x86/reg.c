@@ -57,6 +57,17 @@ void isa_reg_display() {
 }
 
 word_t isa_reg_str2val(const char *s, bool *success) {
-  *success = true;
-  return 0;
+  word_t *reg = isa_reg_ptr(s);
+  *success = (reg != NULL);
+  return (reg ? *reg : 0);
+}
+
+// only the 32-bit registers, since the others can not be pointed to by word_t *
+word_t *isa_reg_ptr(const char *s) {
+  if (s[0] == '$') s ++; // as written in sdb expressions
+  if (strcmp(s, "pc") == 0) return &cpu.pc;
+  for (int i = R_EAX; i <= R_EDI; i ++) {
+    if (strcmp(s, regsl[i]) == 0) return &reg_l(i);
+  }
+  return NULL;
 }
@@ -0,0 +1,209 @@
+/***************************************************************************************
+* Copyright (c) 2014-2024 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#include <memory/cachesim.h>
+#include <cpu/timing.h>
+
+#define LINE_SHIFT __builtin_ctz(CONFIG_CACHE_LINE_SIZE)
+static_assert((CONFIG_CACHE_LINE_SIZE & (CONFIG_CACHE_LINE_SIZE - 1)) == 0,
+    "CACHE_LINE_SIZE should be a power of 2");
+
+/* The tags of a set are contiguous, so looking up a set is a branch-free
+ * compare over a small array which the compiler vectorizes. A tag is the
+ * line number plus 1, and 0 means invalid.
+ */
+typedef uint32_t tag_t;
+
+typedef struct {
+  uint32_t pc, count;
+} MissPC;
+
+typedef struct {
+  const char *name;
+  int nr_set, nr_way;
+  tag_t *tag;
+  uint8_t *dirty;
+  uint64_t *lru;   // the time of the last access to each line
+  uint64_t *plru;  // the tree bits of each set
+  uint64_t clock;
+  uint64_t hit, miss, writeback;
+  MissPC *miss_pc; // open addressing hash table of misses per pc
+  uint32_t miss_pc_size, nr_miss_pc;
+  int next;        // the next level, or -1 for memory
+} Cache;
+
+static Cache caches[NR_CACHE];
+
+static void init_cache(int id, const char *name, int size, int nr_way, int next) {
+  Cache *c = &caches[id];
+  int nr_line = size / CONFIG_CACHE_LINE_SIZE;
+  Assert(nr_line % nr_way == 0 && (nr_way & (nr_way - 1)) == 0 && nr_way <= 64,
+      "invalid associativity of %s", name);
+  c->name = name;
+  c->nr_way = nr_way;
+  c->nr_set = nr_line / nr_way;
+  Assert((c->nr_set & (c->nr_set - 1)) == 0, "the number of sets of %s should be a power of 2", name);
+  c->tag = calloc(nr_line, sizeof(tag_t));
+  c->dirty = calloc(nr_line, 1);
+  c->lru = calloc(nr_line, sizeof(uint64_t));
+  c->plru = calloc(c->nr_set, sizeof(uint64_t));
+  c->miss_pc_size = 1024;
+  c->miss_pc = calloc(c->miss_pc_size, sizeof(MissPC));
+  assert(c->tag && c->dirty && c->lru && c->plru && c->miss_pc);
+  c->next = next;
+}
+
+void init_cachesim() {
+  init_cache(CACHE_L1I, "L1I", CONFIG_CACHE_L1I_SIZE, CONFIG_CACHE_L1I_WAYS, CACHE_L2);
+  init_cache(CACHE_L1D, "L1D", CONFIG_CACHE_L1D_SIZE, CONFIG_CACHE_L1D_WAYS, CACHE_L2);
+  init_cache(CACHE_L2,  "L2",  CONFIG_CACHE_L2_SIZE,  CONFIG_CACHE_L2_WAYS,  -1);
+}
+
+static MissPC *miss_pc_slot(MissPC *t, uint32_t size, uint32_t pc) {
+  uint32_t i = (pc >> 2) * 2654435761u;
+  for (i &= size - 1; t[i].count != 0 && t[i].pc != pc; i = (i + 1) & (size - 1)) ;
+  return &t[i];
+}
+
+static void count_miss_pc(Cache *c, vaddr_t pc) {
+  MissPC *e = miss_pc_slot(c->miss_pc, c->miss_pc_size, pc);
+  if (e->count ++ != 0) return;
+  e->pc = pc;
+  if (++ c->nr_miss_pc * 2 <= c->miss_pc_size) return;
+  uint32_t size = c->miss_pc_size * 2;
+  MissPC *t = calloc(size, sizeof(MissPC));
+  assert(t);
+  for (uint32_t i = 0; i < c->miss_pc_size; i ++) {
+    if (c->miss_pc[i].count) *miss_pc_slot(t, size, c->miss_pc[i].pc) = c->miss_pc[i];
+  }
+  free(c->miss_pc);
+  c->miss_pc = t;
+  c->miss_pc_size = size;
+}
+
+// update the replacement state on an access to `way'
+static void touch(Cache *c, int set, int way) {
+#if defined(CONFIG_CACHE_REPL_LRU)
+  c->lru[set * c->nr_way + way] = ++ c->clock;
+#elif defined(CONFIG_CACHE_REPL_PLRU)
+  // point every node on the path away from `way'
+  uint64_t bits = c->plru[set];
+  for (int node = 1, lo = 0, n = c->nr_way; n > 1; n >>= 1) {
+    bool right = (way >= lo + n / 2);
+    bits = (right ? bits & ~(1ull << node) : bits | (1ull << node));
+    if (right) lo += n / 2;
+    node = node * 2 + right;
+  }
+  c->plru[set] = bits;
+#endif
+}
+
+static int victim(Cache *c, int set) {
+  tag_t *tag = &c->tag[set * c->nr_way];
+  for (int i = 0; i < c->nr_way; i ++) if (tag[i] == 0) return i;
+#if defined(CONFIG_CACHE_REPL_LRU)
+  uint64_t *lru = &c->lru[set * c->nr_way];
+  int v = 0;
+  for (int i = 1; i < c->nr_way; i ++) if (lru[i] < lru[v]) v = i;
+  return v;
+#elif defined(CONFIG_CACHE_REPL_PLRU)
+  uint64_t bits = c->plru[set];
+  int node = 1, lo = 0;
+  for (int n = c->nr_way; n > 1; n >>= 1) {
+    bool right = (bits >> node) & 1;
+    if (right) lo += n / 2;
+    node = node * 2 + right;
+  }
+  return lo;
+#else
+  static uint32_t seed = 1;
+  seed ^= seed << 13; seed ^= seed >> 17; seed ^= seed << 5;
+  return seed % c->nr_way;
+#endif
+}
+
+// return the number of levels missed before the line is found
+static int access_line(int id, tag_t line, bool is_write, vaddr_t pc) {
+  Cache *c = &caches[id];
+  int set = line & (c->nr_set - 1);
+  tag_t *tag = &c->tag[set * c->nr_way];
+  tag_t t = line + 1;
+  int way = -1;
+  for (int i = 0; i < c->nr_way; i ++) way = (tag[i] == t ? i : way);
+
+  if (way >= 0) {
+    c->hit ++;
+    touch(c, set, way);
+    if (is_write) {
+      if (MUXDEF(CONFIG_CACHE_WRITE_BACK, true, false)) c->dirty[set * c->nr_way + way] = 1;
+      else if (c->next >= 0) access_line(c->next, line, true, pc);
+    }
+    return 0;
+  }
+
+  c->miss ++;
+  count_miss_pc(c, pc);
+  if (is_write && !MUXDEF(CONFIG_CACHE_WRITE_BACK, true, false)) {
+    // write-through without allocation
+    if (c->next >= 0) access_line(c->next, line, true, pc);
+    return 1;
+  }
+  way = victim(c, set);
+  int idx = set * c->nr_way + way;
+  if (c->dirty[idx]) {
+    c->writeback ++;
+    if (c->next >= 0) access_line(c->next, tag[way] - 1, true, pc);
+  }
+  int depth = 1 + (c->next >= 0 ? access_line(c->next, line, false, pc) : 0);
+  tag[way] = t;
+  c->dirty[idx] = is_write;
+  touch(c, set, way);
+  return depth;
+}
+
+void cachesim_access(int level, vaddr_t addr, int type, vaddr_t pc) {
+#ifdef CONFIG_TIMING
+  int depth = access_line(level, addr >> LINE_SHIFT, type & CACHE_W, pc);
+  // stores are hidden by the store buffer, but AMOs wait for the old value
+  static const int penalty[] = { 0, CONFIG_TIMING_L2_LATENCY, CONFIG_TIMING_MEM_LATENCY };
+  if (type & CACHE_R) timing_add_stall(penalty[depth]);
+#else
+  access_line(level, addr >> LINE_SHIFT, type & CACHE_W, pc);
+#endif
+}
+
+static int miss_pc_cmp(const void *a, const void *b) {
+  uint32_t x = ((MissPC *)a)->count, y = ((MissPC *)b)->count;
+  return (x < y) - (x > y);
+}
+
+void cachesim_report() {
+  for (int id = 0; id < NR_CACHE; id ++) {
+    Cache *c = &caches[id];
+    uint64_t total = c->hit + c->miss;
+    Log("%-3s: %d sets x %d ways, %" PRIu64 " accesses, %" PRIu64 " hits, %" PRIu64 " misses (%.2f%%), "
+        "%" PRIu64 " writebacks", c->name, c->nr_set, c->nr_way, total, c->hit, c->miss,
+        total ? 100.0 * c->miss / total : 0, c->writeback);
+    if (c->nr_miss_pc == 0) continue;
+    MissPC *m = malloc(sizeof(MissPC) * c->nr_miss_pc);
+    int n = 0;
+    for (uint32_t i = 0; i < c->miss_pc_size; i ++) if (c->miss_pc[i].count) m[n ++] = c->miss_pc[i];
+    qsort(m, n, sizeof(MissPC), miss_pc_cmp);
+    for (int i = 0; i < n && i < 10; i ++) {
+      Log("     pc = " FMT_WORD ": %u misses", (word_t)m[i].pc, m[i].count);
+    }
+    free(m);
+  }
+}
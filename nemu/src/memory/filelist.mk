@@ -0,0 +1,26 @@
+#***************************************************************************************
+# Copyright (c) 2014-2024 Zihao Yu, Nanjing University
+#
+# NEMU is licensed under Mulan PSL v2.
+# You can use this software according to the terms and conditions of the Mulan PSL v2.
+# You may obtain a copy of Mulan PSL v2 at:
+#          http://license.coscl.org.cn/MulanPSL2
+#
+# THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+# EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+# MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+#
+# See the Mulan PSL v2 for more details.
+#**************************************************************************************/
+
+ifndef CONFIG_CACHESIM
+SRCS-BLACKLIST-y += src/memory/cachesim.c
+endif
+
+ifndef CONFIG_MEM_SHADOW
+SRCS-BLACKLIST-y += src/memory/shadow.c
+endif
+
+ifndef CONFIG_WSS
+SRCS-BLACKLIST-y += src/memory/wss.c
+endif
@@ -16,6 +16,10 @@
 #include <memory/host.h>
 #include <memory/paddr.h>
 #include <device/mmio.h>
+#include <memory/cachesim.h>
+#include <memory/shadow.h>
+#include <memory/watch.h>
+#include <cpu/reverse.h>
 #include <isa.h>
 
 #if   defined(CONFIG_PMEM_MALLOC)
@@ -27,12 +31,18 @@ static uint8_t pmem[CONFIG_MSIZE] PG_ALIGN = {};
 uint8_t* guest_to_host(paddr_t paddr) { return pmem + paddr - CONFIG_MBASE; }
 paddr_t host_to_guest(uint8_t *haddr) { return haddr - pmem + CONFIG_MBASE; }
 
-static word_t pmem_read(paddr_t addr, int len) {
+static word_t pmem_read(paddr_t addr, int len, bool fetch) {
+  IFDEF(CONFIG_MEM_SHADOW, shadow_check(addr, len));
+  // instruction fetches are not taken as reads by the range watchpoints
+  if (!fetch) watch_access(addr, len, WATCH_R, 0);
   word_t ret = host_read(guest_to_host(addr), len);
   return ret;
 }
 
 static void pmem_write(paddr_t addr, int len, word_t data) {
+  IFDEF(CONFIG_MEM_SHADOW, shadow_set(addr, len));
+  watch_access(addr, len, WATCH_W, data);
+  IFDEF(CONFIG_REVERSE, rev_write(addr, len));
   host_write(guest_to_host(addr), len, data);
 }
 
@@ -48,17 +58,70 @@ void init_mem() {
 #endif
   IFDEF(CONFIG_MEM_RANDOM, memset(pmem, rand(), CONFIG_MSIZE));
   Log("physical memory area [" FMT_PADDR ", " FMT_PADDR "]", PMEM_LEFT, PMEM_RIGHT);
+  IFDEF(CONFIG_CACHESIM, init_cachesim());
+  IFDEF(CONFIG_MEM_SHADOW, init_shadow());
 }
 
-word_t paddr_read(paddr_t addr, int len) {
-  if (likely(in_pmem(addr))) return pmem_read(addr, len);
+static inline word_t paddr_read_internal(paddr_t addr, int len, bool fetch) {
+  if (likely(in_pmem(addr))) return pmem_read(addr, len, fetch);
   IFDEF(CONFIG_DEVICE, return mmio_read(addr, len));
   out_of_bound(addr);
   return 0;
 }
 
+word_t paddr_ifetch(paddr_t addr, int len) {
+  return paddr_read_internal(addr, len, true);
+}
+
+word_t paddr_read(paddr_t addr, int len) {
+  return paddr_read_internal(addr, len, false);
+}
+
 void paddr_write(paddr_t addr, int len, word_t data) {
   if (likely(in_pmem(addr))) { pmem_write(addr, len, data); return; }
   IFDEF(CONFIG_DEVICE, mmio_write(addr, len, data); return);
   out_of_bound(addr);
 }
+
+static word_t *amo_host_addr(paddr_t addr, int len) {
+  if (unlikely(!in_pmem(addr))) out_of_bound(addr);
+  Assert(len == sizeof(word_t) && (addr & (len - 1)) == 0,
+      "misaligned atomic access at address = " FMT_PADDR ", pc = " FMT_WORD, addr, cpu.pc);
+#ifdef CONFIG_MEM_SHADOW
+  shadow_check(addr, len);
+  shadow_set(addr, len);
+#endif
+  watch_access(addr, len, WATCH_RW, 0);
+  IFDEF(CONFIG_REVERSE, rev_write(addr, len));
+  return (word_t *)guest_to_host(addr);
+}
+
+// return the old value, just like AMO instructions
+word_t paddr_amo(paddr_t addr, int len, int op, word_t data) {
+  word_t *p = amo_host_addr(addr, len);
+  switch (op) {
+    case AMO_SWAP: return __atomic_exchange_n(p, data, __ATOMIC_SEQ_CST);
+    case AMO_ADD:  return __atomic_fetch_add(p, data, __ATOMIC_SEQ_CST);
+    case AMO_XOR:  return __atomic_fetch_xor(p, data, __ATOMIC_SEQ_CST);
+    case AMO_AND:  return __atomic_fetch_and(p, data, __ATOMIC_SEQ_CST);
+    case AMO_OR:   return __atomic_fetch_or (p, data, __ATOMIC_SEQ_CST);
+    default: break;
+  }
+  // there are no host instructions for min/max, so retry with CAS
+  word_t old = __atomic_load_n(p, __ATOMIC_SEQ_CST), val;
+  do {
+    switch (op) {
+      case AMO_MIN:  val = ((sword_t)old < (sword_t)data ? old : data); break;
+      case AMO_MAX:  val = ((sword_t)old > (sword_t)data ? old : data); break;
+      case AMO_MINU: val = (old < data ? old : data); break;
+      case AMO_MAXU: val = (old > data ? old : data); break;
+      default: panic("unsupported AMO op = %d", op);
+    }
+  } while (!__atomic_compare_exchange_n(p, &old, val, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST));
+  return old;
+}
+
+bool paddr_cas(paddr_t addr, int len, word_t expected, word_t data) {
+  word_t *p = amo_host_addr(addr, len);
+  return __atomic_compare_exchange_n(p, &expected, data, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
@@ -0,0 +1,73 @@
+/***************************************************************************************
+* Copyright (c) 2014-2024 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#include <isa.h>
+#include <memory/shadow.h>
+#include <cpu/ftrace.h>
+#include <sys/mman.h>
+#ifdef CONFIG_SMP_THREAD
+#include <pthread.h>
+static pthread_mutex_t report_lock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+#define SHADOW_SIZE (CONFIG_MSIZE / 8 + 2) // the check reads one byte past the end
+#define NR_REPORTED_PC 1024
+
+uint8_t *shadow = NULL;
+
+// each pc is only reported on its first undefined read
+static vaddr_t reported_pc[NR_REPORTED_PC];
+static int nr_reported_pc = 0;
+static uint64_t nr_undefined_read = 0;
+
+void init_shadow() {
+  shadow = mmap(NULL, SHADOW_SIZE, PROT_READ | PROT_WRITE,
+      MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  Assert(shadow != MAP_FAILED, "Can not map the shadow memory");
+}
+
+void shadow_define(paddr_t addr, size_t len) {
+  for (; len > 0 && (addr & 7); addr ++, len --) shadow_set(addr, 1);
+  word_t off = addr - CONFIG_MBASE;
+  memset(shadow + (off >> 3), 0xff, len >> 3);
+  addr += len & ~7;
+  for (len &= 7; len > 0; addr ++, len --) shadow_set(addr, 1);
+}
+
+void shadow_undefined_read(paddr_t addr, int len) {
+  // the monitor (e.g. `x' of sdb) may read anything
+  if (nemu_state.state != NEMU_RUNNING) return;
+  IFDEF(CONFIG_SMP_THREAD, pthread_mutex_lock(&report_lock));
+  nr_undefined_read ++;
+  vaddr_t pc = cpu.pc;
+  bool is_new = (nr_reported_pc < NR_REPORTED_PC);
+  for (int i = 0; is_new && i < nr_reported_pc; i ++) is_new = (reported_pc[i] != pc);
+  if (is_new) reported_pc[nr_reported_pc ++] = pc;
+  int nr = nr_reported_pc;
+  IFDEF(CONFIG_SMP_THREAD, pthread_mutex_unlock(&report_lock));
+  if (!is_new || nr > CONFIG_MEM_SHADOW_MAX_REPORT) return;
+
+  const ElfSym *sym = MUXDEF(CONFIG_TARGET_NATIVE_ELF, elf_lookup(pc), NULL);
+  char where[64] = "";
+  if (sym != NULL) snprintf(where, sizeof(where), " <%s+0x%x>", sym->name, (uint32_t)(pc - sym->start));
+  Warn("read of uninitialized memory at " FMT_PADDR ", len = %d, pc = " FMT_WORD "%s",
+      addr, len, pc, where);
+}
+
+void shadow_report() {
+  if (nr_undefined_read == 0) return;
+  Log("%" PRIu64 " reads of uninitialized memory by %d%s pcs", nr_undefined_read,
+      nr_reported_pc, nr_reported_pc == NR_REPORTED_PC ? "+" : "");
+}
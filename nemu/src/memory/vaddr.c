@@ -15,15 +15,55 @@
 
 #include <isa.h>
 #include <memory/paddr.h>
+#include <cpu/cpu.h>
+#include <cpu/itrace.h>
+#include <cpu/plugin.h>
+#include <cpu/pipeline.h>
+#include <memory/cachesim.h>
+#include <memory/wss.h>
 
 word_t vaddr_ifetch(vaddr_t addr, int len) {
-  return paddr_read(addr, len);
+  cachesim_ifetch(addr);
+  IFDEF(CONFIG_WSS, wss_access(WSS_INST, addr));
+  return paddr_ifetch(addr, len);
 }
 
 word_t vaddr_read(vaddr_t addr, int len) {
-  return paddr_read(addr, len);
+  hpm_count(HPM_EV_LOAD);
+  itrace_mem(addr);
+  cachesim_data(addr, CACHE_R);
+  IFDEF(CONFIG_WSS, wss_access(WSS_DATA, addr));
+  word_t ret;
+  hprof_phase(HP_MEM, ret = paddr_read(addr, len));
+  plugin_event(PLUGIN_EV_MEM, plugin_mem_access(addr, len, false, ret));
+  pipe_put(PIPE_LOAD, cpu.pc, addr, len, false);
+  return ret;
 }
 
 void vaddr_write(vaddr_t addr, int len, word_t data) {
-  paddr_write(addr, len, data);
+  hpm_count(HPM_EV_STORE);
+  itrace_mem(addr);
+  cachesim_data(addr, CACHE_W);
+  IFDEF(CONFIG_WSS, wss_access(WSS_DATA, addr));
+  hprof_phase(HP_MEM, paddr_write(addr, len, data));
+  plugin_event(PLUGIN_EV_MEM, plugin_mem_access(addr, len, true, data));
+  pipe_put(PIPE_STORE, cpu.pc, addr, len, false);
+}
+
+word_t vaddr_amo(vaddr_t addr, int len, int op, word_t data) {
+  itrace_mem(addr);
+  cachesim_data(addr, CACHE_RW);
+  IFDEF(CONFIG_WSS, wss_access(WSS_DATA, addr));
+  word_t ret;
+  hprof_phase(HP_MEM, ret = paddr_amo(addr, len, op, data));
+  return ret;
+}
+
+bool vaddr_cas(vaddr_t addr, int len, word_t expected, word_t data) {
+  itrace_mem(addr);
+  cachesim_data(addr, CACHE_RW);
+  IFDEF(CONFIG_WSS, wss_access(WSS_DATA, addr));
+  bool ret;
+  hprof_phase(HP_MEM, ret = paddr_cas(addr, len, expected, data));
+  return ret;
 }
@@ -0,0 +1,170 @@
+/***************************************************************************************
+* Copyright (c) 2014-2024 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#include <memory/wss.h>
+
+extern uint64_t g_nr_guest_inst;
+
+#define NR_LINE (CONFIG_MSIZE >> WSS_LINE_SHIFT)
+#define NR_PAGE (CONFIG_MSIZE >> WSS_PAGE_SHIFT)
+// the time of an access is an index into the Fenwick tree, and there are
+// at most NR_LINE live times, so the tree is compacted before it is full
+#define NR_TIME (NR_LINE * 2)
+
+bool wss_on = false;
+uint64_t wss_next = UINT64_MAX;
+
+/* The Fenwick tree has 1 at the time of the last access to each line,
+ * so the reuse distance of an access is the sum over the times after the
+ * last access to its line.
+ */
+typedef struct {
+  uint32_t *last;     // time of the last access to each line, 0 if never
+  uint32_t *tree;     // Fenwick tree indexed by time from 1
+  uint32_t now;       // time of the latest access
+  uint32_t start;     // time of the latest access before the interval
+  uint8_t *page_map;  // pages touched in the interval
+  uint64_t nr_access, nr_line, nr_page, hist[WSS_NR_BUCKET];
+} Stream;
+
+static Stream streams[NR_WSS_STREAM];
+static uint32_t *page_heat = NULL; // accesses of both streams to each page in the interval
+static uint64_t interval_start_inst = 0;
+static FILE *wss_fp = NULL;
+
+static inline void tree_add(uint32_t *tree, uint32_t i, int v) {
+  for (; i < NR_TIME; i += i & -i) tree[i] += v;
+}
+
+static inline uint32_t tree_sum(uint32_t *tree, uint32_t i) {
+  uint32_t sum = 0;
+  for (; i > 0; i -= i & -i) sum += tree[i];
+  return sum;
+}
+
+// renumber the live times from 1 while keeping their order
+static void compact(Stream *s) {
+  uint32_t *line_at = s->tree; // reused as the line + 1 accessed at each time
+  memset(line_at, 0, sizeof(uint32_t) * NR_TIME);
+  for (uint32_t l = 0; l < NR_LINE; l ++) {
+    if (s->last[l] != 0) line_at[s->last[l]] = l + 1;
+  }
+  uint32_t t = 0, start = 0;
+  for (uint32_t i = 1; i < NR_TIME; i ++) {
+    if (line_at[i] == 0) continue;
+    s->last[line_at[i] - 1] = ++ t;
+    if (i <= s->start) start = t;
+  }
+  s->now = t;
+  s->start = start;
+
+  // build the tree with ones at [1, t] in linear time
+  memset(s->tree, 0, sizeof(uint32_t) * NR_TIME);
+  for (uint32_t i = 1; i < NR_TIME; i ++) {
+    s->tree[i] += (i <= t);
+    uint32_t j = i + (i & -i);
+    if (j < NR_TIME) s->tree[j] += s->tree[i];
+  }
+}
+
+void wss_record(int stream, paddr_t addr) {
+  word_t off = addr - CONFIG_MBASE;
+  if (off >= CONFIG_MSIZE) return; // MMIO
+  Stream *s = &streams[stream];
+  if (s->now + 1 == NR_TIME) compact(s);
+
+  uint32_t line = off >> WSS_LINE_SHIFT, page = off >> WSS_PAGE_SHIFT;
+  uint32_t t = ++ s->now;
+  uint32_t last = s->last[line];
+  int bucket = 0;
+  if (last != 0) {
+    uint32_t dist = tree_sum(s->tree, t - 1) - tree_sum(s->tree, last);
+    bucket = (dist == 0 ? 1 : 2 + 31 - __builtin_clz(dist));
+    tree_add(s->tree, last, -1);
+  }
+  tree_add(s->tree, t, 1);
+  s->last[line] = t;
+  s->hist[bucket] ++;
+  s->nr_access ++;
+  s->nr_line += (last <= s->start);
+  if (!(s->page_map[page >> 3] & (1 << (page & 7)))) {
+    s->page_map[page >> 3] |= 1 << (page & 7);
+    s->nr_page ++;
+  }
+  page_heat[page] ++;
+}
+
+void wss_interval() {
+  if (wss_fp == NULL) return;
+  uint64_t head[2] = { interval_start_inst, g_nr_guest_inst - interval_start_inst };
+  fwrite(head, sizeof(head), 1, wss_fp);
+  for (int i = 0; i < NR_WSS_STREAM; i ++) {
+    Stream *s = &streams[i];
+    uint64_t count[3] = { s->nr_access, s->nr_line, s->nr_page };
+    fwrite(count, sizeof(count), 1, wss_fp);
+    fwrite(s->hist, sizeof(s->hist), 1, wss_fp);
+    s->nr_access = s->nr_line = s->nr_page = 0;
+    memset(s->hist, 0, sizeof(s->hist));
+    memset(s->page_map, 0, NR_PAGE / 8);
+    s->start = s->now;
+  }
+
+  uint32_t nr = 0;
+  for (uint32_t p = 0; p < NR_PAGE; p ++) nr += (page_heat[p] != 0);
+  fwrite(&nr, sizeof(nr), 1, wss_fp);
+  for (uint32_t p = 0; p < NR_PAGE; p ++) if (page_heat[p]) fwrite(&p, sizeof(p), 1, wss_fp);
+  for (uint32_t p = 0; p < NR_PAGE; p ++) if (page_heat[p]) fwrite(&page_heat[p], sizeof(uint32_t), 1, wss_fp);
+  memset(page_heat, 0, sizeof(uint32_t) * NR_PAGE);
+
+  interval_start_inst = g_nr_guest_inst;
+  wss_next = g_nr_guest_inst + CONFIG_WSS_INTERVAL;
+}
+
+void wss_close() {
+  if (wss_fp == NULL) return;
+  if (g_nr_guest_inst > interval_start_inst) wss_interval();
+  fclose(wss_fp);
+  wss_fp = NULL;
+  wss_on = false;
+}
+
+void init_wss(const char *file) {
+  if (file == NULL) return;
+  wss_fp = fopen(file, "wb");
+  Assert(wss_fp, "Can not open '%s'", file);
+  for (int i = 0; i < NR_WSS_STREAM; i ++) {
+    Stream *s = &streams[i];
+    // only the parts of touched memory are allocated by the host
+    s->last = calloc(NR_LINE, sizeof(uint32_t));
+    s->tree = calloc(NR_TIME, sizeof(uint32_t));
+    s->page_map = calloc(NR_PAGE / 8, 1);
+    assert(s->last && s->tree && s->page_map);
+  }
+  page_heat = calloc(NR_PAGE, sizeof(uint32_t));
+  assert(page_heat);
+
+  char magic[8] = "NEMUWSS1";
+  uint32_t hdr[4] = { WSS_LINE_SHIFT, WSS_PAGE_SHIFT, WSS_NR_BUCKET, 0 };
+  uint64_t base = CONFIG_MBASE;
+  fwrite(magic, sizeof(magic), 1, wss_fp);
+  fwrite(hdr, sizeof(hdr), 1, wss_fp);
+  fwrite(&base, sizeof(base), 1, wss_fp);
+
+  interval_start_inst = g_nr_guest_inst;
+  wss_next = g_nr_guest_inst + CONFIG_WSS_INTERVAL;
+  wss_on = true;
+  atexit(wss_close);
+  Log("Working set analysis is written to %s", file);
+}
@@ -15,9 +15,22 @@
 
 #include <isa.h>
 #include <memory/paddr.h>
+#include <memory/shadow.h>
 
 void init_rand();
 void init_log(const char *log_file);
+void log_set_level(int level);
+void log_set_debug(const char *mods);
+void init_itrace(const char *file);
+void init_elf(const char *file);
+void init_ftrace(const char *file);
+void init_profile(const char *file);
+void init_inst_stat(const char *file);
+void init_coverage(const char *file);
+void init_timeline(const char *file);
+void init_wss(const char *file);
+void load_plugin(const char *spec);
+bool bpred_select(const char *name);
 void init_mem();
 void init_difftest(char *ref_so_file, long img_size, int port);
 void init_device();
@@ -45,6 +58,17 @@ void sdb_set_batch_mode();
 static char *log_file = NULL;
 static char *diff_so_file = NULL;
 static char *img_file = NULL;
+static char *itrace_file = NULL;
+static char *elf_file = NULL;
+static char *ftrace_file = NULL;
+static char *profile_file = NULL;
+static char *inst_stat_file = NULL;
+static char *cov_file = NULL;
+static char *timeline_file = NULL;
+static char *wss_file = NULL;
+static char *plugin_spec[8] = {};
+static int nr_plugin = 0;
+static char *bpred_name = NULL;
 static int difftest_port = 1234;
 
 static long load_img() {
@@ -75,16 +99,43 @@ static int parse_args(int argc, char *argv[]) {
     {"log"      , required_argument, NULL, 'l'},
     {"diff"     , required_argument, NULL, 'd'},
     {"port"     , required_argument, NULL, 'p'},
+    {"itrace"   , required_argument, NULL, 't'},
+    {"elf"      , required_argument, NULL, 'e'},
+    {"ftrace"   , required_argument, NULL, 'f'},
+    {"profile"  , required_argument, NULL, 'P'},
+    {"inst-stat", required_argument, NULL, 's'},
+    {"coverage" , required_argument, NULL, 'c'},
+    {"timeline" , required_argument, NULL, 'T'},
+    {"wss"      , required_argument, NULL, 'w'},
+    {"plugin"   , required_argument, NULL, 'x'},
+    {"bpred"    , required_argument, NULL, 'B'},
+    {"log-level", required_argument, NULL, 'L'},
+    {"log-debug", required_argument, NULL, 'D'},
     {"help"     , no_argument      , NULL, 'h'},
     {0          , 0                , NULL,  0 },
   };
   int o;
-  while ( (o = getopt_long(argc, argv, "-bhl:d:p:", table, NULL)) != -1) {
+  while ( (o = getopt_long(argc, argv, "-bhl:d:p:t:e:f:P:s:c:T:w:x:B:L:D:", table, NULL)) != -1) {
     switch (o) {
       case 'b': sdb_set_batch_mode(); break;
       case 'p': sscanf(optarg, "%d", &difftest_port); break;
       case 'l': log_file = optarg; break;
       case 'd': diff_so_file = optarg; break;
+      case 't': itrace_file = optarg; break;
+      case 'e': elf_file = optarg; break;
+      case 'f': ftrace_file = optarg; break;
+      case 'P': profile_file = optarg; break;
+      case 's': inst_stat_file = optarg; break;
+      case 'c': cov_file = optarg; break;
+      case 'T': timeline_file = optarg; break;
+      case 'w': wss_file = optarg; break;
+      case 'x':
+        Assert(nr_plugin < ARRLEN(plugin_spec), "Too many plugins");
+        plugin_spec[nr_plugin ++] = optarg;
+        break;
+      case 'B': bpred_name = optarg; break;
+      case 'L': log_set_level(atoi(optarg)); break;
+      case 'D': log_set_debug(optarg); break;
       case 1: img_file = optarg; return 0;
       default:
         printf("Usage: %s [OPTION...] IMAGE [args]\n\n", argv[0]);
@@ -92,6 +143,18 @@ static int parse_args(int argc, char *argv[]) {
         printf("\t-l,--log=FILE           output log to FILE\n");
         printf("\t-d,--diff=REF_SO        run DiffTest with reference REF_SO\n");
         printf("\t-p,--port=PORT          run DiffTest with port PORT\n");
+        printf("\t-t,--itrace=FILE        write the binary instruction trace to FILE\n");
+        printf("\t-e,--elf=FILE           read the function symbols of the guest from FILE\n");
+        printf("\t-f,--ftrace=FILE        write the function call trace to FILE\n");
+        printf("\t-P,--profile=FILE       write the sampled guest call stacks to FILE\n");
+        printf("\t-s,--inst-stat=FILE     count executed pcs and instructions, and write them to FILE\n");
+        printf("\t-c,--coverage=FILE      accumulate the code coverage into FILE\n");
+        printf("\t-T,--timeline=FILE      write a Chrome trace-event timeline to FILE\n");
+        printf("\t-w,--wss=FILE           write the working sets and reuse distances of each interval to FILE\n");
+        printf("\t-x,--plugin=SO[,ARGS]   load the plugin SO with ARGS, can be repeated\n");
+        printf("\t-B,--bpred=MODEL        simulate the branch predictor MODEL (bimodal, gshare, tage)\n");
+        printf("\t-L,--log-level=LEVEL    only log messages up to LEVEL (0: error, 1: warn, 2: info, 3: debug)\n");
+        printf("\t-D,--log-debug=MODS     log debug messages of MODS (isa,cpu,mem,dev,sdb or all)\n");
         printf("\n");
         exit(0);
     }
@@ -111,6 +174,26 @@ void init_monitor(int argc, char *argv[]) {
   /* Open the log file. */
   init_log(log_file);
 
+  /* Open the binary instruction trace. */
+  IFDEF(CONFIG_ITRACE_BIN, init_itrace(itrace_file));
+
+  /* Read the symbols of the guest program and open the function trace. */
+  init_elf(elf_file);
+  IFDEF(CONFIG_FTRACE, init_ftrace(ftrace_file));
+  IFDEF(CONFIG_PROFILE, init_profile(profile_file));
+  IFDEF(CONFIG_INST_STAT, init_inst_stat(inst_stat_file));
+  IFDEF(CONFIG_COVERAGE, init_coverage(cov_file));
+  IFDEF(CONFIG_TIMELINE, init_timeline(timeline_file));
+  IFDEF(CONFIG_WSS, init_wss(wss_file));
+
+  /* Load the instrumentation plugins. */
+  IFDEF(CONFIG_PLUGIN, for (int i = 0; i < nr_plugin; i ++) load_plugin(plugin_spec[i]));
+
+  /* Select the branch predictor model. */
+#ifdef CONFIG_BPRED
+  if (bpred_name != NULL && !bpred_select(bpred_name)) panic("Unknown branch predictor '%s'", bpred_name);
+#endif
+
   /* Initialize memory. */
   init_mem();
 
@@ -122,6 +205,7 @@ void init_monitor(int argc, char *argv[]) {
 
   /* Load the image to memory. This will overwrite the built-in image. */
   long img_size = load_img();
+  IFDEF(CONFIG_MEM_SHADOW, shadow_define(RESET_VECTOR, img_size));
 
   /* Initialize differential testing. */
   init_difftest(diff_so_file, img_size, difftest_port);
@@ -129,7 +213,10 @@ void init_monitor(int argc, char *argv[]) {
   /* Initialize the simple debugger. */
   init_sdb();
 
-  IFDEF(CONFIG_ITRACE, init_disasm());
+  // the disassembler of riscv needs no initialization
+#if (defined(CONFIG_ITRACE) || defined(CONFIG_IQUEUE)) && !defined(CONFIG_ISA_riscv)
+  init_disasm();
+#endif
 
   /* Display welcome message. */
   welcome();
@@ -0,0 +1,118 @@
+/***************************************************************************************
+* Copyright (c) 2014-2024 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#include <isa.h>
+#include <memory/paddr.h>
+#include <cpu/reverse.h>
+#include "sdb.h"
+
+/* Breakpoints are kept in a list, and their pcs are also marked in a
+ * bitmap with one bit for each 4-byte slot of pmem. The exec loop only
+ * tests the bitmap, and the list is searched and the compiled conditions
+ * are evaluated when the bit of the current pc is set.
+ */
+typedef struct breakpoint {
+  int NO;
+  vaddr_t pc;
+  char *cond;       // NULL if the breakpoint is unconditional
+  ExprCode *code;
+  uint64_t nr_hit;
+  struct breakpoint *next;
+} BP;
+
+uint8_t *bp_map = NULL;
+int nr_bp = 0;
+uint64_t bp_start_inst = 0;
+static BP *bp_head = NULL;
+static int next_bp_NO = 1;
+
+static void bp_map_update(vaddr_t pc) {
+  bool set = false;
+  for (BP *bp = bp_head; bp != NULL; bp = bp->next) set |= (bp->pc == pc);
+  word_t idx = (pc - CONFIG_MBASE) >> 2;
+  if (set) bp_map[idx >> 3] |= 1 << (idx & 7);
+  else bp_map[idx >> 3] &= ~(1 << (idx & 7));
+}
+
+int new_bp(vaddr_t pc, char *cond) {
+  if (!in_pmem(pc) || (pc & 3)) {
+    printf("Invalid breakpoint address " FMT_WORD "\n", pc);
+    return -1;
+  }
+  ExprCode *code = NULL;
+  if (cond != NULL) {
+    bool success = true;
+    code = expr_compile(cond, &success);
+    if (code == NULL) {
+      printf("Invalid condition %s\n", cond);
+      return -1;
+    }
+  }
+  if (bp_map == NULL) {
+    bp_map = calloc(BP_NR_SLOT / 8, 1);
+    assert(bp_map);
+  }
+  BP *bp = malloc(sizeof(BP));
+  assert(bp);
+  *bp = (BP) { .NO = next_bp_NO ++, .pc = pc, .cond = (cond ? strdup(cond) : NULL), .code = code, .next = bp_head };
+  bp_head = bp;
+  nr_bp ++;
+  bp_map_update(pc);
+  return bp->NO;
+}
+
+bool free_bp(int NO) {
+  for (BP **p = &bp_head; *p != NULL; p = &(*p)->next) {
+    BP *bp = *p;
+    if (bp->NO != NO) continue;
+    *p = bp->next;
+    nr_bp --;
+    bp_map_update(bp->pc);
+    free(bp->cond);
+    expr_free(bp->code);
+    free(bp);
+    return true;
+  }
+  return false;
+}
+
+void breakpoint_display() {
+  for (BP *bp = bp_head; bp != NULL; bp = bp->next) {
+    printf("Breakpoint %d at " FMT_WORD, bp->NO, bp->pc);
+    if (bp->cond) printf(" if %s", bp->cond);
+    printf(", hit %" PRIu64 " times\n", bp->nr_hit);
+  }
+}
+
+// called by the exec loop when the bit of `pc' is set
+bool bp_check(vaddr_t pc) {
+  // the replays of reverse execution only stop when searching for a hit
+  IFDEF(CONFIG_REVERSE, if (rev_mode == REV_REPLAY) return false);
+  bool stop = false;
+  for (BP *bp = bp_head; bp != NULL; bp = bp->next) {
+    if (bp->pc != pc) continue;
+    if (bp->code != NULL) {
+      bool success = true;
+      word_t val = expr_eval(bp->code, &success);
+      if (!success) printf("Can not evaluate the condition of breakpoint %d\n", bp->NO);
+      else if (val == 0) continue;
+    }
+    stop = true;
+    if (!rev_live()) continue;
+    bp->nr_hit ++;
+    printf("Breakpoint %d at " FMT_WORD "\n", bp->NO, pc);
+  }
+  return stop;
+}
@@ -20,6 +20,8 @@
  */
 #include <regex.h>
 #include <memory/paddr.h>
+#include <memory/host.h>
+#include "sdb.h"
 
 // encode for tokens
 enum {
@@ -87,7 +89,7 @@ word_t get_priority(Token token) {
       pri = 0;
     }
   }
-  Log("Priority of %s is %d", token.str, pri);
+  Debug(LOG_SDB, "Priority of %s is %d", token.str, pri);
   return pri;
 }
 
@@ -119,7 +121,7 @@ static struct rule {
   {"[0-9]+", TK_DECIMAL}, 
   {"\\(", TK_LEFT_P},// (
   {"\\)", TK_RIGHT_P},// )
-  {"\\$(\\$0|ra|sp|gp|tp|t0|t1|t2|s0|s1|a0|a1|a2|a3|a4|a5|a6|a7|s2|s3|s4|s5|s6|s7|s8|s9|s10|s11|t3|t4|t5|t6)", TK_REGISTER},
+  {"\\$(\\$0|ra|sp|gp|tp|t0|t1|t2|s0|s1|a0|a1|a2|a3|a4|a5|a6|a7|s2|s3|s4|s5|s6|s7|s8|s9|s10|s11|t3|t4|t5|t6|pc)", TK_REGISTER},
 };
 // len(rules)
 #define NR_REGEX ARRLEN(rules)
@@ -179,7 +181,7 @@ static bool make_token(char *e) {
         char *substr_start = e + position; // where substr starts
         int substr_len = pmatch.rm_eo;
 
-        Log("match rules[%d] = \"%s\" at position %d with len %d: %.*s",
+        Debug(LOG_SDB, "match rules[%d] = \"%s\" at position %d with len %d: %.*s",
             i, rules[i].regex, position, substr_len, substr_len, substr_start);
         
         position += substr_len;// skip to go to next token
@@ -208,7 +210,7 @@ static bool make_token(char *e) {
             break;
           }
           case TK_NOT: {
-            Log("Not implemented");
+            Warn("Not implemented");
             return false;
             Token newToken = {.type = rules[i].token_type, .str = ""};
             strncpy(newToken.str, substr_start, substr_len);
@@ -218,7 +220,7 @@ static bool make_token(char *e) {
           }
           default: 
             push_token(substr_start, substr_len, i);
-            Log("default"); // panic
+            Debug(LOG_SDB, "default"); // panic
         }
         break;
       }
@@ -233,7 +235,114 @@ static bool make_token(char *e) {
   return true;
 }
 
-word_t eval(word_t p, word_t q, bool *success);
+/* Expressions are compiled once into postfix code, which is run on a small
+ * stack. Watchpoints and breakpoint conditions keep the code and run it
+ * after each instruction, so the tokens are never matched again.
+ */
+enum {
+  OP_IMM, OP_REG, OP_DEREF,
+  OP_ADD, OP_SUB, OP_MUL, OP_DIV, OP_AND, OP_OR, OP_EQ, OP_NEQ,
+};
+
+typedef struct {
+  int type;
+  union {
+    word_t imm;
+    word_t *reg;
+  };
+} ExprOp;
+
+struct ExprCode {
+  int nr_op;
+  ExprOp op[MAX_TOKENS];
+};
+
+static bool compile(word_t p, word_t q, ExprCode *c);
+
+static bool emit(ExprCode *c, ExprOp op) {
+  assert(c->nr_op < MAX_TOKENS);
+  c->op[c->nr_op ++] = op;
+  return true;
+}
+
+ExprCode *expr_compile(char *e, bool *success) {
+  if (!make_token(e) || nr_token == 0) {
+    *success = false;
+    return NULL;
+  }
+  ExprCode *c = malloc(sizeof(ExprCode));
+  assert(c);
+  c->nr_op = 0;
+  if (!compile(0, nr_token - 1, c)) {
+    free(c);
+    *success = false;
+    return NULL;
+  }
+  Debug(LOG_SDB, "Compiled %s into %d ops", e, c->nr_op);
+  return c;
+}
+
+void expr_free(ExprCode *c) {
+  free(c);
+}
+
+word_t expr_eval(ExprCode *c, bool *success) {
+  word_t stack[MAX_TOKENS];
+  int top = 0;
+  for (ExprOp *op = c->op; op < c->op + c->nr_op; op ++) {
+    switch (op->type) {
+      case OP_IMM: stack[top ++] = op->imm; continue;
+      case OP_REG: stack[top ++] = *op->reg; continue;
+      case OP_DEREF: {
+        // read pmem directly, so that the debugger is invisible to the
+        // memory checkers of the guest
+        word_t addr = stack[top - 1];
+        if (!in_pmem(addr)) {
+          *success = false;
+          return 0;
+        }
+        stack[top - 1] = host_read(guest_to_host(addr), 1);
+        continue;
+      }
+      default: break;
+    }
+    word_t r = stack[-- top], l = stack[top - 1], val = 0;
+    switch (op->type) {
+      case OP_ADD: val = l + r; break;
+      case OP_SUB: val = l - r; break;
+      case OP_MUL: val = l * r; break;
+      case OP_DIV:
+        if (r == 0) {
+          *success = false;
+          return 0;
+        }
+        val = l / r;
+        break;
+      case OP_AND: val = l && r; break;
+      case OP_OR:  val = l || r; break;
+      case OP_EQ:  val = l == r; break;
+      case OP_NEQ: val = l != r; break;
+      default: panic("unknown op %d", op->type);
+    }
+    stack[top - 1] = val;
+  }
+  assert(top == 1);
+  return stack[0];
+}
+
+// return the number of the addresses read by `c', or -1 if `c' also
+// depends on registers or on addresses computed from memory
+int expr_mem_addr(ExprCode *c, paddr_t *addr, int max) {
+  int n = 0;
+  for (int i = 0; i < c->nr_op; i ++) {
+    if (c->op[i].type == OP_REG) return -1;
+    if (c->op[i].type != OP_DEREF) continue;
+    if (c->op[i - 1].type != OP_IMM || n == max) return -1;
+    addr[n ++] = c->op[i - 1].imm;
+  }
+  return n;
+}
+
 word_t expr(char *e, bool *success) {
   // init the return val
   if(*success == false){
@@ -241,21 +350,19 @@ word_t expr(char *e, bool *success) {
     return 0;
   }
 
-  if (!make_token(e)) {
+  ExprCode *c = expr_compile(e, success);
+  if (c == NULL) {
     Warn("Fail to get the expression value. Returning 0");
-    *success = false;
     return 0;
   }
-  Log("Successfully make token, now evaluating");
-  word_t value = eval((word_t) 0, (word_t) (nr_token - 1), success);
+  Debug(LOG_SDB, "Successfully compile the expression, now evaluating");
+  word_t value = expr_eval(c, success);
+  expr_free(c);
   if(!*success) {
     Warn("Fail to get the expression value. Returning 0");
+    printf("Invalid address or division by zero in the expression\n");
   }
   return value;
-  // may check the validity of the tokens here
-  
-
-  // return 0;
 }
 
 bool check_parentheses(word_t p, word_t q) {
@@ -303,70 +410,9 @@ bool check_single_operator(word_t p,word_t q) {
   } else return false;
 }
 
-static word_t deal_double_operator(word_t left_half_val, 
-  word_t right_half_val, word_t master_position, bool *success);
+static bool compile_operand(word_t p, ExprCode *c);
 
-static word_t deal_single_operator(word_t master_position, word_t rval, bool *success);
-
-static word_t deal_orpand(word_t p, bool*success);
-
-static word_t find_master_operator(word_t p, word_t q, bool *success);
-
-word_t eval(word_t p, word_t q, bool* success) {
-  /* Get the evaluation of the expression from p to q.
-   * q is included.*/
-  if (*success == false) {
-    return 0;
-  };
-  if (tokens[p].type == TK_NOTYPE) {
-    return eval(p + 1, q, success);
-  }
-  if (tokens[q].type == TK_NOTYPE) {
-    return eval(p, q - 1, success);
-  }
-  if (p > q) {
-    Log("Invalid expression provided: left is greater than right");
-    Warn("Invalid expression provided!");
-    *success = false;
-    return 0;
-  }
-  else if (p == q) {
-    // It is a single token. number/ register
-    word_t value = deal_orpand(p, success);
-    if(!(*success)) return 0;
-    return value;
-  }
-  else if (check_parentheses(p, q) == true) {
-    /* The expression is surrounded by a matched pair of parentheses.
-     * If that is the case, just throw away the parentheses.
-      */
-    Log("remove parentheses at %u-%u", p, q);
-    return eval(p + 1, q - 1, success);
-  } 
-  // get the master operator, which is the one with the lowest priority
-
-  word_t master_position = find_master_operator(p, q, success);
-  if (!(*success)) return 0;
-
-  Log("Master operator found at %d : %s", master_position, tokens[master_position].str);
-
-  if (check_single_operator(master_position, -1)) {
-    word_t rval = eval(p + 1, q, success);
-    word_t value = deal_single_operator(rval, master_position, success);
-    if(!(*success)) return 0;
-    return value;
-  }
-
-  word_t left_half_val = eval(p, master_position - 1, success);
-  word_t right_half_val = eval(master_position + 1, q, success);
-  word_t value = deal_double_operator(left_half_val, 
-    right_half_val, master_position, success);
-  if(!(*success)) return 0;
-  return value;
-  Warn("Not a recognized double operator!");
-  *success = false;
-  return 0;
-}
+static bool compile_operator(word_t master_position, ExprCode *c);
 
 static word_t find_master_operator(word_t p, word_t q, bool *success) {
   int i = 0;
@@ -404,104 +450,82 @@ static word_t find_master_operator(word_t p, word_t q, bool *success) {
   return master_position;
 }
 
-static word_t deal_orpand(word_t p, bool*success){
-  word_t r = 0;
-  switch (tokens[p].type) {
-    case TK_DECIMAL: {
-      r = strtoul(tokens[p].str, NULL, 10);
-      break;
-    }
-    case TK_HEX: {
-      r = strtoul(tokens[p].str, NULL, 16);
-      break;
-    }
-    case TK_REGISTER: {
-      r = isa_reg_str2val(tokens[p].str, success);
-      if(!(*success)) return 0;
-      break;
-    }
-    default: {
-      // panic("Internal Wrong, Can not get the evaluation of the expression!");
-      Warn("Not recognized token type when p == q. May add more numeric cases.");
-      *success = false;
-      return 0;
-    }
+static bool compile(word_t p, word_t q, ExprCode *c) {
+  /* Compile the expression from p to q.
+   * q is included.*/
+  if (p > q) {
+    Debug(LOG_SDB, "Invalid expression provided: left is greater than right");
+    Warn("Invalid expression provided!");
+    return false;
   }
-  return r;
-}
+  if (tokens[p].type == TK_NOTYPE) {
+    return compile(p + 1, q, c);
+  }
+  if (tokens[q].type == TK_NOTYPE) {
+    return compile(p, q - 1, c);
+  }
+  if (p == q) {
+    // It is a single token. number/ register
+    return compile_operand(p, c);
+  }
+  else if (check_parentheses(p, q) == true) {
+    /* The expression is surrounded by a matched pair of parentheses.
+     * If that is the case, just throw away the parentheses.
+      */
+    Debug(LOG_SDB, "remove parentheses at %u-%u", p, q);
+    return compile(p + 1, q - 1, c);
+  }
+  // get the master operator, which is the one with the lowest priority
+  bool success = true;
+  word_t master_position = find_master_operator(p, q, &success);
+  if (!success) return false;
 
+  Debug(LOG_SDB, "Master operator found at %d : %s", master_position, tokens[master_position].str);
 
+  if (check_single_operator(master_position, -1)) {
+    return compile(p + 1, q, c) && compile_operator(master_position, c);
+  }
+  return compile(p, master_position - 1, c) && compile(master_position + 1, q, c) &&
+    compile_operator(master_position, c);
+}
 
-static word_t deal_single_operator(word_t rval, word_t master_position, bool *success) {
-  word_t p = master_position;
-  switch (tokens[p].type){
-    case TK_DEREF:{
-      // get right value
-      // derefrence
-      // if (rval == 0 || (uintptr_t)rval % sizeof(word_t) != 0) {
-      //     panic("Invalid memory address for dereference");
-      // }
-      if (rval < 0x80000000 || rval > 0x87ffffff) {
-        Warn("Not a effective address.");
-        printf("Invalid address. Use effective addr: [0x80000000, 0x87ffffff]\n");
-        *(success) = false;
-        return 0;
+static bool compile_operand(word_t p, ExprCode *c) {
+  switch (tokens[p].type) {
+    case TK_DECIMAL:
+      return emit(c, (ExprOp) { .type = OP_IMM, .imm = strtoul(tokens[p].str, NULL, 10) });
+    case TK_HEX:
+      return emit(c, (ExprOp) { .type = OP_IMM, .imm = strtoul(tokens[p].str, NULL, 16) });
+    case TK_REGISTER: {
+      word_t *reg = isa_reg_ptr(tokens[p].str);
+      if (reg == NULL) {
+        Warn("Unknown register %s", tokens[p].str);
+        return false;
       }
-      Log("Derefrencing address 0x%x\n", rval);
-      return paddr_read(rval, 1);
-      break;
+      return emit(c, (ExprOp) { .type = OP_REG, .reg = reg });
     }
     default: {
-      Warn("NO SUCH OPREATOR! Something may went wrong with check single operator");
-      *success = false;
-      return 0;
-      break;
+      Warn("Not recognized token type when p == q. May add more numeric cases.");
+      return false;
     }
   }
 }
 
-static word_t deal_double_operator(word_t left_half_val, 
-  word_t right_half_val, word_t master_position, bool *success) {
-
+static bool compile_operator(word_t master_position, ExprCode *c) {
+  int type;
   switch (tokens[master_position].type) {
-    case TK_ADD:{
-      Log("Opreator found %s", tokens[master_position].str);
-      return left_half_val + right_half_val;
-    };
-    case TK_SUB:{
-      Log("Opreator found %s", tokens[master_position].str);
-      return left_half_val - right_half_val;
-    }
-    case TK_MUL:{
-      Log("Opreator found %s", tokens[master_position].str);
-      return left_half_val * right_half_val;
-    }
-    case TK_DIV:{
-      Log("Opreator found %s", tokens[master_position].str);
-      if (right_half_val == 0) {
-        panic("Division by zero");
-      }
-      return left_half_val / right_half_val;
-    }
-    case TK_AND: {
-      Log("Opreator found %s", tokens[master_position].str);
-      return left_half_val && right_half_val;
-    }
-    case TK_OR: {
-      Log("Opreator found %s", tokens[master_position].str);
-      return left_half_val || right_half_val;
-    }
-    case TK_EQ: {
-      Log("Opreator found %s", tokens[master_position].str);
-      return left_half_val == right_half_val;
-    }
-    case TK_NEQ: {
-      Log("Opreator found %s", tokens[master_position].str);
-      return left_half_val != right_half_val;
-    }
+    case TK_DEREF: type = OP_DEREF; break;
+    case TK_ADD: type = OP_ADD; break;
+    case TK_SUB: type = OP_SUB; break;
+    case TK_MUL: type = OP_MUL; break;
+    case TK_DIV: type = OP_DIV; break;
+    case TK_AND: type = OP_AND; break;
+    case TK_OR:  type = OP_OR;  break;
+    case TK_EQ:  type = OP_EQ;  break;
+    case TK_NEQ: type = OP_NEQ; break;
     default:
-      Log("Unrecognized operator %s", tokens[master_position].str);
-      *success = false;
+      Warn("Unrecognized operator %s", tokens[master_position].str);
+      return false;
   }
-  return 0;
-}
\ No newline at end of file
+  Debug(LOG_SDB, "Opreator found %s", tokens[master_position].str);
+  return emit(c, (ExprOp) { .type = type });
+}
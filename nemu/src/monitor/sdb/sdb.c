@@ -20,11 +20,11 @@
 #include "sdb.h"
 
 #include <memory/paddr.h>
+#include <memory/watch.h>
 
 static int is_batch_mode = false;
 
 void init_regex();
-void init_wp_pool();
 
 /* We use the `readline' library to provide more flexibility to read from stdin. */
 static char* rl_gets() {
@@ -65,34 +65,85 @@ static int cmd_p(char *args) {
 }
 
 static int cmd_w(char *args) {
-  // panic("Not implemnted");
-  word_t value;
   if(args == NULL) {
     printf("Usage: w <expr>\n");
     return 0;
   }
   bool suc = true;
-  bool *success = & suc;
-  // word_t is just like uint (4 bytes)
-  value = expr(args, success);
-  if(!*success) {
+  Debug(LOG_SDB, "Expression: %s", args);
+  WP* newWp = new_wp(args, &suc);
+  if(!suc) {
     printf("Invalid expression. Watchpoint is not added.\n");
     return 0;
   }
-  // printf("%d\n", val);
-  char* x = args;
-  Log("Expression: %s", x);
-  WP* newWp = new_wp(args, success);
-  // a->expr = "i love you";
-  if(!*success) {
-      printf("Failed to create watchpoint\n");
-      return 0;
-  }
-  newWp->last_value = value;
   printf("New watchpoint %d created\n", newWp->NO);
   return 0;
 }
 
+// watch-range <addr> <len> [r|w|rw]
+static int cmd_watch_range(char *args) {
+  char *addr_str = strtok(args, " ");
+  char *len_str = strtok(NULL, " ");
+  char *type_str = strtok(NULL, " ");
+  int type = WATCH_W;
+  if (type_str != NULL) {
+    type = (strcmp(type_str, "r") == 0 ? WATCH_R : strcmp(type_str, "w") == 0 ? WATCH_W :
+        strcmp(type_str, "rw") == 0 ? WATCH_RW : 0);
+  }
+  if (len_str == NULL || type == 0) {
+    printf("Usage: watch-range <addr> <len> [r|w|rw]\n");
+    return 0;
+  }
+  bool suc = true;
+  paddr_t addr = expr(addr_str, &suc);
+  word_t len = (suc ? expr(len_str, &suc) : 0);
+  if (!suc) {
+    printf("Invalid expression. Watchpoint is not added.\n");
+    return 0;
+  }
+  int NO = new_watch_range(addr, len, type);
+  if (NO >= 0) printf("New watchpoint %d created\n", NO);
+  return 0;
+}
+
+// b <expr> [if <cond>]
+static int cmd_b(char *args) {
+  if (args == NULL) {
+    printf("Usage: b <expr> [if <cond>]\n");
+    return 0;
+  }
+#ifdef CONFIG_SMP_THREAD
+  // harts run on separate host threads, which can not share the expression evaluator
+  printf("Breakpoints are not supported with SMP_THREAD\n");
+  return 0;
+#endif
+  char *cond = strstr(args, " if ");
+  if (cond != NULL) {
+    *cond = '\0';
+    cond += strlen(" if ");
+  }
+  bool suc = true;
+  word_t pc = expr(args, &suc);
+  if (!suc) {
+    printf("Invalid expression. Breakpoint is not added.\n");
+    return 0;
+  }
+  int NO = new_bp(pc, cond);
+  if (NO >= 0) printf("Breakpoint %d at " FMT_WORD "\n", NO, pc);
+  return 0;
+}
+
+static int cmd_bd(char *args) {
+  if (args == NULL) {
+    printf("Usage: bd <breakpoint number>\n");
+    return 0;
+  }
+  int NO = atoi(args);
+  if (free_bp(NO)) printf("Breakpoint %d deleted\n", NO);
+  else printf("Breakpoint %d does not exist\n", NO);
+  return 0;
+}
+
 static int cmd_si(char *args) {
   if (args == NULL) {
     cpu_exec(1);
@@ -104,14 +155,18 @@ static int cmd_si(char *args) {
 }
 
 static int cmd_info(char *args) {
-  if (strcmp(args, "r") == 0) {
+  if (args == NULL) {
+    printf("Usage: info r for reg, w for watchpoints, b for breakpoints\n");
+  } else if (strcmp(args, "r") == 0) {
     // Log("command : info r");
     isa_reg_display();
   } else if (strcmp(args, "w") == 0) {
     watchpoint_display();
     // panic("Not implemented");
+  } else if (strcmp(args, "b") == 0) {
+    breakpoint_display();
   } else {
-    printf("Usage: info r for reg, w for watchpoints\n");
+    printf("Usage: info r for reg, w for watchpoints, b for breakpoints\n");
   }
   return 0;
 }
@@ -128,7 +183,7 @@ static int cmd_x(char *args) {
     printf("Usage: x <byte_count(expression)> <address(hex)>\n");
     return 0;
   };
-  Log("Translating expression to integers.");
+  Debug(LOG_SDB, "Translating expression to integers.");
   word_t byte_count = expr(arg_bc, success);
   if(!*success) {
     printf("Invalid expression for byte count\n");
@@ -171,28 +226,6 @@ static int cmd_x(char *args) {
   return 0;
 }
 
-static int cmd_go(char *args) {
-  // test anything
-  // init_wp_pool();
-  bool* success = malloc(sizeof(bool));
-  *success = true;
-  int count = 0;
-  while(true){
-    *success = true;
-    char* x = "aaa";
-    WP* a = new_wp(x, success);
-    Log("Created watchpoints %d", count);
-    Log("address of the watchpoint is %p",a);
-    // a->expr = "i love you";
-    count++;
-    if(!*success) {
-        printf("Failed to create watchpoint\n");
-        break;
-      }
-  }
-  return 0;
-}
-
 static int cmd_d(char* args) {
   if(args == NULL) {
     printf("Usage: d <watchpoint Number(expr)>\n");
@@ -214,6 +247,44 @@ static int cmd_d(char* args) {
   return 0;
 }
 
+#ifdef CONFIG_REVERSE
+#include <cpu/reverse.h>
+
+static void rev_done() {
+  sync_watchpoint();
+  extern uint64_t g_nr_guest_inst;
+  printf("Now at instruction %" PRIu64 ", pc = " FMT_WORD "\n", g_nr_guest_inst, cpu.pc);
+}
+
+static int cmd_rsi(char *args) {
+  uint64_t n = 1;
+  if (args != NULL && sscanf(args, "%" SCNu64, &n) != 1) {
+    printf("Usage: rsi [N]\n");
+    return 0;
+  }
+  if (rev_step(n)) rev_done();
+  return 0;
+}
+
+static int cmd_rc(char *args) {
+  if (rev_continue()) rev_done();
+  return 0;
+}
+#endif
+
+#ifdef CONFIG_BPRED
+#include <cpu/bpred.h>
+static int cmd_bpred(char *args) {
+  char *arg = strtok(NULL, " ");
+  if (arg == NULL) {
+    bpred_report();
+    return 0;
+  }
+  if (!bpred_select(arg)) printf("Unknown branch predictor '%s', use off, bimodal, gshare or tage\n", arg);
+  return 0;
+}
+#endif
+
 static int cmd_help(char *args);
 
 static struct {
@@ -230,8 +301,17 @@ static struct {
   { "info", "Display the status of the program", cmd_info},
   { "x", "Examine memory", cmd_x},
   { "w", "Create a watchpoint", cmd_w},
-  { "go", "test", cmd_go},
+  { "watch-range", "Break on reads and/or writes of an address range, e.g. watch-range 0x80100000 0x100000 w", cmd_watch_range},
   { "d", "Delete a watchpoint by watchpoint number", cmd_d},
+  { "b", "Break before the instruction at the address of the expression, optionally only if the condition is true", cmd_b},
+  { "bd", "Delete a breakpoint by breakpoint number", cmd_bd},
+#ifdef CONFIG_REVERSE
+  { "rsi", "Step back N instructions, 1 by default", cmd_rsi},
+  { "rc", "Go back to the last hit of a breakpoint", cmd_rc},
+#endif
+#ifdef CONFIG_BPRED
+  { "bpred", "Select the branch predictor (off, bimodal, gshare, tage), or report it without arguments", cmd_bpred},
+#endif
   // { "d", "Delete a watchpoint", cmd_d},
 
   /* TODO: Add more commands */
@@ -269,7 +349,6 @@ void sdb_set_batch_mode() {
 void sdb_mainloop() {
   // for test
   // generate_some_pointers();
-  // init_wp_pool();
   if (is_batch_mode) {
     cmd_c(NULL);
     return;
@@ -310,7 +389,4 @@ void sdb_mainloop() {
 void init_sdb() {
   /* Compile the regular expressions. */
   init_regex();
-
-  /* Initialize the watchpoint pool. */
-  init_wp_pool();
 }
@@ -15,35 +15,60 @@
 
 #ifndef __SDB_H__
 #define __SDB_H__
-#define MAX_EXPR_LEN 64
 #include <common.h>
 
-// See expr.c. token are used to store the tokens of the expression.
-// Saving token will make it quicker to evaluate the expression.
-// may do this later
-// we have not hit the limit yet
-// remember to make eval accecpt tokens as a parameter when we do that optimization
-
-// typedef struct token {
-//   int type;
-//   char str[32];
-// } Token;
-
 // get a value from a string expression
 word_t expr(char *e, bool *success);
-// word_t eval;
+// expressions compiled once and evaluated many times, see expr.c
+typedef struct ExprCode ExprCode;
+ExprCode *expr_compile(char *e, bool *success);
+word_t expr_eval(ExprCode *c, bool *success);
+void expr_free(ExprCode *c);
+int expr_mem_addr(ExprCode *c, paddr_t *addr, int max);
+
+#define WP_MAX_ADDR 8
 typedef struct watchpoint {
   int NO;
   struct watchpoint *next;
-  char expr[MAX_EXPR_LEN];
-  bool vacant;
+  char *expr;
+  ExprCode *code;
   word_t last_value; // the last value of the expression
-  /* TODO: Add more members if necessary */
-
+  int nr_addr;       // -1 if the expression does not only read memory
+  paddr_t addr[WP_MAX_ADDR];
 } WP;
 WP* new_wp(char* e ,bool* success);
 void watchpoint_display();
 void free_wp(int wpNO, bool* success);
-void check_watchpoint();
+bool check_watchpoint(vaddr_t pc);
+void sync_watchpoint();
+int new_watch_range(paddr_t start, word_t len, int type);
 void toggle_wp(bool target_status);
+
+/* Watchpoints only reading memory at constant addresses are checked when
+ * one of their addresses is written, see memory/watch.h. The others are
+ * checked after each instruction. With SMP_THREAD, the watchpoints are
+ * only checked when cpu_exec() returns.
+ */
+extern int nr_wp, nr_wp_reg;
+extern bool wp_mem_hit;
+static inline bool wp_pending() {
+  return MUXDEF(CONFIG_SMP_THREAD, false, nr_wp > 0 && (nr_wp_reg > 0 || wp_mem_hit));
+}
+
+// pc breakpoints, see breakpoint.c
+#define BP_NR_SLOT (CONFIG_MSIZE >> 2)
+extern uint8_t *bp_map;
+extern int nr_bp;
+extern uint64_t bp_start_inst; // the instruction count when cpu_exec() starts
+int new_bp(vaddr_t pc, char *cond);
+bool free_bp(int NO);
+void breakpoint_display();
+bool bp_check(vaddr_t pc);
+
+// the instruction where cpu_exec() starts is never stopped at
+static inline bool bp_hit(vaddr_t pc, uint64_t nr_inst) {
+  word_t idx = (pc - CONFIG_MBASE) >> 2;
+  return idx < BP_NR_SLOT && ((bp_map[idx >> 3] >> (idx & 7)) & 1) &&
+    nr_inst != bp_start_inst && bp_check(pc);
+}
 #endif
@@ -13,119 +13,220 @@
 * See the Mulan PSL v2 for more details.
 ***************************************************************************************/
 
+#include <isa.h>
+#include <memory/paddr.h>
+#include <memory/host.h>
+#include <memory/watch.h>
+#include <cpu/reverse.h>
 #include "sdb.h"
 
-#define NR_WP 3
+static WP *head = NULL;
+static int next_wp_NO = 1;
+static bool toggle = true;
 
-// typedef struct watchpoint {
-//   int NO;
-//   struct watchpoint *next;
-  
-//   /* TODO: Add more members if necessary */
+int nr_wp = 0;
+int nr_wp_reg = 0; // watchpoints checked after each instruction
+bool wp_mem_hit = false;
 
-// } WP;
+// sorted addresses read by the watchpoints only reading memory
+static paddr_t *wp_addr = NULL;
+int nr_wp_addr = 0;
 
-static WP wp_pool[NR_WP] = {};
-static WP *head = NULL, *free_ = NULL;
-static bool toggle = true;
+static int addr_cmp(const void *a, const void *b) {
+  paddr_t x = *(const paddr_t *)a, y = *(const paddr_t *)b;
+  return (x > y) - (x < y);
+}
 
+static void wp_update() {
+  int n = 0;
+  nr_wp_reg = 0;
+  for (WP *wp = head; wp != NULL; wp = wp->next) {
+    if (wp->nr_addr < 0) nr_wp_reg ++;
+    else n += wp->nr_addr;
+  }
+  wp_addr = realloc(wp_addr, sizeof(paddr_t) * (n > 0 ? n : 1));
+  assert(wp_addr);
+  n = 0;
+  for (WP *wp = head; wp != NULL; wp = wp->next) {
+    for (int i = 0; i < wp->nr_addr; i ++) wp_addr[n ++] = wp->addr[i];
+  }
+  qsort(wp_addr, n, sizeof(paddr_t), addr_cmp);
+  int m = 0;
+  for (int i = 0; i < n; i ++) {
+    if (m == 0 || wp_addr[m - 1] != wp_addr[i]) wp_addr[m ++] = wp_addr[i];
+  }
+  nr_wp_addr = m;
+}
 
-void init_wp_pool() {
-  if(head != NULL) return;
-  Log("Initializing watchpoint pool.");
-  int i;
-  wp_pool[0].NO = 0;
-  wp_pool[0].next = &wp_pool[1];
-  wp_pool[0].vacant = true;
-  head = wp_pool;
-  for (i = 1; i < NR_WP; i ++) { 
-    wp_pool[i].NO = i;
-    wp_pool[i].next = (i == NR_WP - 1 ? NULL : &wp_pool[i + 1]);
-    wp_pool[i].vacant = true;
-    Log("Initializing watchpoint %d, vacant = %d", i, wp_pool[i].vacant);
-  }
-  free_ = wp_pool; // set free to the first element
-  Log("Watchpoint pool initialized. free_ = %p, head = %p", free_, head);
+// called by the memory when [addr, addr + len) is written
+void wp_mem_write(paddr_t addr, int len) {
+  // find the first watched address not less than `addr'
+  int l = 0, r = nr_wp_addr;
+  while (l < r) {
+    int mid = (l + r) / 2;
+    if (wp_addr[mid] < addr) l = mid + 1;
+    else r = mid;
+  }
+  if (l < nr_wp_addr && wp_addr[l] - addr < len) wp_mem_hit = true;
 }
 
-/* TODO: Implement the functionality of watchpoint */
-// static void info_wp(WP* wp) {
-  // Log("=+=+=+=+=");
-  // Log("Watchpoint NO: %d", wp->NO);
-  // Log("Watchpoint value: %s", wp->expr);
-  // Log("Watchpoint vacant: %d", wp->vacant);
-  // Log("=+=+=+=+=");
-// }
+// range watchpoints share the numbers with the expression watchpoints
+typedef struct watchrange {
+  int NO;
+  paddr_t start;
+  word_t len;
+  int type;
+  struct watchrange *next;
+} WR;
 
-WP* new_wp(char* e ,bool* success) {
-  Log("Adding new watch point, expr = %s",e);
-  for (word_t i = 0; i < NR_WP + 1; i++)
-  {
-    // Log("Checking wp at %d", i);
-    // info_wp();
-    if(free_-> vacant == true) {
-      Log("Find a vacant wp in pool: %d", free_->NO);
-      strcpy(free_ -> expr, e);
-      free_-> vacant = false;
-      *success = true;
-      return free_;
-    }
-    if(free_->next != NULL) {
-      free_ = free_->next;
+static WR *range_head = NULL;
+int nr_watch_range = 0;
+uint8_t watch_page_map[WATCH_NR_PAGE / 8] = {};
+
+static const char *watch_type_str[] = { [WATCH_R] = "r", [WATCH_W] = "w", [WATCH_RW] = "rw" };
+
+static void watch_page_update() {
+  memset(watch_page_map, 0, sizeof(watch_page_map));
+  for (WR *wr = range_head; wr != NULL; wr = wr->next) {
+    paddr_t first = (wr->start - CONFIG_MBASE) >> PAGE_SHIFT;
+    paddr_t last = (wr->start + wr->len - 1 - CONFIG_MBASE) >> PAGE_SHIFT;
+    for (paddr_t pg = first; pg <= last; pg ++) watch_page_map[pg >> 3] |= 1 << (pg & 7);
+  }
+}
+
+int new_watch_range(paddr_t start, word_t len, int type) {
+  if (len == 0 || !in_pmem(start) || !in_pmem(start + len - 1) || start + len - 1 < start) {
+    printf("Invalid range [" FMT_PADDR ", " FMT_PADDR ")\n", start, (paddr_t)(start + len));
+    return -1;
+  }
+  WR *wr = malloc(sizeof(WR));
+  assert(wr);
+  *wr = (WR) { .NO = next_wp_NO ++, .start = start, .len = len, .type = type };
+  WR **p = &range_head;
+  while (*p != NULL) p = &(*p)->next;
+  *p = wr;
+  nr_watch_range ++;
+  watch_page_update();
+  return wr->NO;
+}
+
+static bool free_watch_range(int NO) {
+  for (WR **p = &range_head; *p != NULL; p = &(*p)->next) {
+    WR *wr = *p;
+    if (wr->NO != NO) continue;
+    *p = wr->next;
+    nr_watch_range --;
+    watch_page_update();
+    free(wr);
+    return true;
+  }
+  return false;
+}
+
+// called by the memory for accesses to marked pages
+void watch_range_access(paddr_t addr, int len, int type, word_t data) {
+  // accesses by the monitor and the replays of reverse execution are not reported
+  if (nemu_state.state != NEMU_RUNNING || !rev_live()) return;
+  for (WR *wr = range_head; wr != NULL; wr = wr->next) {
+    if (!(wr->type & type) || addr + len <= wr->start || addr >= wr->start + wr->len) continue;
+    word_t old = host_read(guest_to_host(addr), len);
+    const char *what = (type == WATCH_R ? "read" : type == WATCH_W ? "write" : "amo");
+    printf("Watchpoint %d: %s of %d bytes at " FMT_PADDR " at pc = " FMT_WORD "\n",
+        wr->NO, what, len, addr, cpu.pc);
+    if (type == WATCH_W) {
+      word_t mask = (len == sizeof(word_t) ? (word_t)-1 : ((word_t)1 << (len * 8)) - 1);
+      printf("Old value = " FMT_WORD "\nNew value = " FMT_WORD "\n", old, data & mask);
     } else {
-      free_ = wp_pool;
+      printf("Value = " FMT_WORD "\n", old);
     }
+    // stop after the instruction
+    nemu_state.state = NEMU_STOP;
+    return;
   }
-  Log("No vacant watch point in pool. Returning NULL");
-  *success = false;
-  return NULL;
+}
+
+WP* new_wp(char* e ,bool* success) {
+  Debug(LOG_SDB, "Adding new watch point, expr = %s",e);
+  ExprCode *code = expr_compile(e, success);
+  if (code == NULL) return NULL;
+  word_t value = expr_eval(code, success);
+  if (!*success) {
+    expr_free(code);
+    return NULL;
+  }
+  WP *wp = malloc(sizeof(WP));
+  assert(wp);
+  *wp = (WP) { .NO = next_wp_NO ++, .expr = strdup(e), .code = code, .last_value = value };
+  wp->nr_addr = expr_mem_addr(code, wp->addr, WP_MAX_ADDR);
+  // append, so the watchpoints are displayed and checked in order
+  WP **p = &head;
+  while (*p != NULL) p = &(*p)->next;
+  *p = wp;
+  nr_wp ++;
+  wp_update();
+  return wp;
 }
 
 void free_wp(int wpNO, bool* success) {
-  // make that place vacant for next allocation
-  Log("Freeing watch point %d", wpNO);
-  if(wpNO < 0 || wpNO >= NR_WP) {
-    *success = false;
+  Debug(LOG_SDB, "Freeing watch point %d", wpNO);
+  for (WP **p = &head; *p != NULL; p = &(*p)->next) {
+    WP *wp = *p;
+    if (wp->NO != wpNO) continue;
+    *p = wp->next;
+    nr_wp --;
+    wp_update();
+    expr_free(wp->code);
+    free(wp->expr);
+    free(wp);
     return;
   }
-  wp_pool[wpNO].vacant = true;
-  free_ = &wp_pool[wpNO];
-  return;
+  if (!free_watch_range(wpNO)) *success = false;
 }
 
 void watchpoint_display() {
-  for (word_t i = 0; i < NR_WP; i++) {
-    if(wp_pool[i].vacant) {
-      continue;
-    }
-    printf("Watchpoint %d, tracking expr: %s\n", i, wp_pool[i].expr);
+  for (WP *wp = head; wp != NULL; wp = wp->next) {
+    printf("Watchpoint %d, tracking expr: %s, value = " FMT_WORD "%s\n", wp->NO, wp->expr,
+        wp->last_value, (wp->nr_addr >= 0 ? " (memory)" : ""));
+  }
+  for (WR *wr = range_head; wr != NULL; wr = wr->next) {
+    printf("Watchpoint %d, tracking range: [" FMT_PADDR ", " FMT_PADDR "), %s\n", wr->NO,
+        wr->start, (paddr_t)(wr->start + wr->len), watch_type_str[wr->type]);
   }
-  return;
 }
 
-void check_watchpoint() {
-  // check watchpoint here
-  if(!toggle) {
-    return;
+// return whether the value of some watchpoint is changed by the
+// instruction at `pc'
+bool check_watchpoint(vaddr_t pc) {
+  if(!toggle || !rev_live()) {
+    return false;
   }
-  bool success = true;
-  for (word_t i = 0; i < NR_WP; i++)
-  {
-    if(wp_pool[i].vacant) {
-      continue;
-    }
-    // this may cost some extra time
-    word_t value = expr(wp_pool[i].expr, &success);
-    if(!success) {
-      panic("HALT: Unexpected error when checking watchpoint: unexpected modification on expr!");
-    }
-    if (wp_pool[i].last_value == value) {
-      continue;
-    }
-    wp_pool[i].last_value = value;
-    printf("WP %d: %s is now %d\n", i, wp_pool[i].expr, value);
+  bool mem_hit = wp_mem_hit;
+  wp_mem_hit = false;
+  bool changed = false;
+  for (WP *wp = head; wp != NULL; wp = wp->next) {
+    if (wp->nr_addr >= 0 && !mem_hit) continue;
+    bool success = true;
+    word_t value = expr_eval(wp->code, &success);
+    // e.g. the address of a dereference is out of pmem for now
+    if (!success || value == wp->last_value) continue;
+    printf("Watchpoint %d: %s at pc = " FMT_WORD "\n", wp->NO, wp->expr, pc);
+    printf("Old value = " FMT_WORD "\nNew value = " FMT_WORD "\n", wp->last_value, value);
+    wp->last_value = value;
+    changed = true;
   }
+  return changed;
 }
+
+// take the current values silently, e.g. after going back in time
+void sync_watchpoint() {
+  wp_mem_hit = false;
+  for (WP *wp = head; wp != NULL; wp = wp->next) {
+    bool success = true;
+    word_t value = expr_eval(wp->code, &success);
+    if (success) wp->last_value = value;
+  }
+}
+
 void toggle_wp(bool target_status) {
   if(!target_status) {
     Log("Watchpoint disabled");
@@ -133,4 +234,4 @@ void toggle_wp(bool target_status) {
     Log("Watchpoint enabled");
   }
   toggle = target_status;
-}
\ No newline at end of file
+}
@@ -19,7 +19,6 @@ void init_monitor(int, char *[]);
 void am_init_monitor();
 void engine_start();
 int is_exit_status_bad();
-void init_wp_pool();
 
 int main(int argc, char *argv[]) {
   /* Initialize the monitor. */
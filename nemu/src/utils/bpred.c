@@ -0,0 +1,307 @@
+/***************************************************************************************
+* Copyright (c) 2014-2024 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#include <cpu/bpred.h>
+#include <cpu/ftrace.h>
+#include <cpu/timing.h>
+
+int bpred_model = BP_OFF;
+
+static const char *model_name[] = {
+  [BP_OFF] = "off", [BP_BIMODAL] = "bimodal", [BP_GSHARE] = "gshare", [BP_TAGE] = "tage",
+};
+static const char *kind_name[] = {
+  [BP_COND] = "branch", [BP_CALL] = "call", [BP_RET] = "return", [BP_JUMP] = "jump",
+};
+
+#define BIMODAL_BITS 12
+#define GSHARE_BITS  14
+#define BTB_BITS     10
+#define RAS_SIZE     16
+#define TOP_BRANCH   20
+
+static uint64_t ghr; // global history of conditional branches, the newest in bit 0
+
+// 2-bit saturating counters, predict taken if >= 2
+static uint8_t bimodal[1 << BIMODAL_BITS];
+static uint8_t gshare[1 << GSHARE_BITS];
+
+static inline void ctr2_update(uint8_t *c, bool taken) {
+  if (taken) { if (*c < 3) (*c) ++; }
+  else { if (*c > 0) (*c) --; }
+}
+
+static inline uint32_t bimodal_idx(vaddr_t pc) {
+  return (pc >> 2) & ((1 << BIMODAL_BITS) - 1);
+}
+
+static inline uint32_t gshare_idx(vaddr_t pc) {
+  return ((pc >> 2) ^ ghr) & ((1 << GSHARE_BITS) - 1);
+}
+
+/* TAGE-lite: a bimodal base predictor and tagged tables indexed with
+ * geometrically longer global histories. The longest matching table
+ * provides the prediction, and a misprediction allocates an entry in a
+ * longer table.
+ */
+#define TAGE_NR_TABLE 4
+#define TAGE_IDX_BITS 10
+#define TAGE_TAG_BITS 9
+static const int tage_hist_len[TAGE_NR_TABLE] = { 4, 8, 16, 32 };
+
+typedef struct {
+  uint16_t tag;
+  int8_t ctr;    // 3-bit signed, predict taken if >= 0
+  uint8_t u;     // 2-bit usefulness
+} TageEntry;
+
+static TageEntry tage[TAGE_NR_TABLE][1 << TAGE_IDX_BITS];
+
+static inline uint32_t fold(uint64_t h, int len, int bits) {
+  h &= (len == 64 ? ~0ull : (1ull << len) - 1);
+  uint32_t ret = 0;
+  for (; h != 0; h >>= bits) ret ^= h & ((1u << bits) - 1);
+  return ret;
+}
+
+static inline uint32_t tage_idx(int t, vaddr_t pc) {
+  return ((pc >> 2) ^ (pc >> (2 + TAGE_IDX_BITS)) ^ fold(ghr, tage_hist_len[t], TAGE_IDX_BITS)) &
+    ((1 << TAGE_IDX_BITS) - 1);
+}
+
+static inline uint16_t tage_tag(int t, vaddr_t pc) {
+  return ((pc >> 2) ^ fold(ghr, tage_hist_len[t], TAGE_TAG_BITS) ^
+    (fold(ghr, tage_hist_len[t], TAGE_TAG_BITS - 1) << 1)) & ((1 << TAGE_TAG_BITS) - 1);
+}
+
+static bool tage_predict_update(vaddr_t pc, bool taken) {
+  uint32_t idx[TAGE_NR_TABLE];
+  uint16_t tag[TAGE_NR_TABLE];
+  int provider = -1, alt = -1;
+  for (int t = 0; t < TAGE_NR_TABLE; t ++) {
+    idx[t] = tage_idx(t, pc);
+    tag[t] = tage_tag(t, pc);
+  }
+  for (int t = TAGE_NR_TABLE - 1; t >= 0; t --) {
+    if (tage[t][idx[t]].tag != tag[t]) continue;
+    if (provider < 0) provider = t;
+    else { alt = t; break; }
+  }
+
+  uint8_t *base = &bimodal[bimodal_idx(pc)];
+  bool base_pred = (*base >= 2);
+  bool alt_pred = (alt >= 0 ? tage[alt][idx[alt]].ctr >= 0 : base_pred);
+  bool pred = base_pred;
+
+  if (provider >= 0) {
+    TageEntry *e = &tage[provider][idx[provider]];
+    pred = (e->ctr >= 0);
+    if (pred != alt_pred) {
+      if (pred == taken) { if (e->u < 3) e->u ++; }
+      else if (e->u > 0) e->u --;
+    }
+    if (taken) { if (e->ctr < 3) e->ctr ++; }
+    else if (e->ctr > -4) e->ctr --;
+  } else {
+    ctr2_update(base, taken);
+  }
+
+  if (pred != taken && provider < TAGE_NR_TABLE - 1) {
+    bool allocated = false;
+    for (int t = provider + 1; t < TAGE_NR_TABLE; t ++) {
+      TageEntry *e = &tage[t][idx[t]];
+      if (e->u != 0) continue;
+      *e = (TageEntry) { .tag = tag[t], .ctr = (taken ? 0 : -1), .u = 0 };
+      allocated = true;
+      break;
+    }
+    if (!allocated) {
+      for (int t = provider + 1; t < TAGE_NR_TABLE; t ++) {
+        if (tage[t][idx[t]].u > 0) tage[t][idx[t]].u --;
+      }
+    }
+  }
+  return pred;
+}
+
+// predict the direction of a conditional branch and train the predictor
+static bool direction(vaddr_t pc, bool taken) {
+  bool pred;
+  switch (bpred_model) {
+    case BP_BIMODAL: {
+      uint8_t *c = &bimodal[bimodal_idx(pc)];
+      pred = (*c >= 2);
+      ctr2_update(c, taken);
+      break;
+    }
+    case BP_GSHARE: {
+      uint8_t *c = &gshare[gshare_idx(pc)];
+      pred = (*c >= 2);
+      ctr2_update(c, taken);
+      break;
+    }
+    case BP_TAGE: pred = tage_predict_update(pc, taken); break;
+    default: panic("bad branch predictor model = %d", bpred_model);
+  }
+  ghr = (ghr << 1) | taken;
+  return pred;
+}
+
+static struct {
+  vaddr_t pc, target;
+  bool valid;
+} btb[1 << BTB_BITS];
+
+// return whether the BTB has the correct target, and train it
+static bool btb_access(vaddr_t pc, vaddr_t target) {
+  typeof(btb[0]) *e = &btb[(pc >> 2) & ((1 << BTB_BITS) - 1)];
+  bool hit = (e->valid && e->pc == pc && e->target == target);
+  e->pc = pc;
+  e->target = target;
+  e->valid = true;
+  return hit;
+}
+
+static vaddr_t ras[RAS_SIZE];
+static uint32_t ras_top = 0; // it wraps around, so the oldest entries are overwritten
+
+/* Statistics of each static branch, in an open addressing hash table. */
+typedef struct {
+  vaddr_t pc;
+  uint8_t kind;
+  uint64_t exec, miss;
+} BranchStat;
+
+static BranchStat *stat = NULL;
+static uint32_t stat_size = 0, nr_stat = 0;
+static uint64_t kind_exec[NR_BP_KIND], kind_miss[NR_BP_KIND];
+
+static BranchStat *stat_slot(BranchStat *t, uint32_t size, vaddr_t pc) {
+  uint32_t i = (pc >> 1) * 2654435761u;
+  for (i &= size - 1; t[i].exec != 0 && t[i].pc != pc; i = (i + 1) & (size - 1)) ;
+  return &t[i];
+}
+
+static void stat_grow() {
+  uint32_t size = (stat_size ? stat_size * 2 : 4096);
+  BranchStat *t = calloc(size, sizeof(BranchStat));
+  assert(t);
+  for (uint32_t i = 0; i < stat_size; i ++) {
+    if (stat[i].exec) *stat_slot(t, size, stat[i].pc) = stat[i];
+  }
+  free(stat);
+  stat = t;
+  stat_size = size;
+}
+
+void bpred_update(vaddr_t pc, int kind, bool taken, vaddr_t target, vaddr_t ret_addr) {
+  bool miss;
+  switch (kind) {
+    case BP_COND: {
+      bool pred = direction(pc, taken);
+      // a taken branch is only redirected at fetch when the BTB knows the target
+      miss = (pred != taken) || (taken && !btb_access(pc, target));
+      break;
+    }
+    case BP_RET:
+      ras_top --;
+      miss = (ras[ras_top % RAS_SIZE] != target);
+      break;
+    case BP_CALL:
+      ras[ras_top % RAS_SIZE] = ret_addr;
+      ras_top ++;
+      // fall through
+    default: miss = !btb_access(pc, target); break;
+  }
+
+  if ((nr_stat + 1) * 2 > stat_size) stat_grow();
+  BranchStat *s = stat_slot(stat, stat_size, pc);
+  if (s->exec ++ == 0) {
+    s->pc = pc;
+    s->kind = kind;
+    nr_stat ++;
+  }
+  s->miss += miss;
+  if (miss) timing_add_stall(CONFIG_TIMING_BRANCH_PENALTY);
+  kind_exec[kind] ++;
+  kind_miss[kind] += miss;
+}
+
+static void reset() {
+  memset(bimodal, 0, sizeof(bimodal));
+  memset(gshare, 0, sizeof(gshare));
+  memset(tage, 0, sizeof(tage));
+  memset(btb, 0, sizeof(btb));
+  ghr = 0;
+  ras_top = 0;
+  free(stat);
+  stat = NULL;
+  stat_size = nr_stat = 0;
+  memset(kind_exec, 0, sizeof(kind_exec));
+  memset(kind_miss, 0, sizeof(kind_miss));
+}
+
+// the predictor and the statistics restart from scratch
+bool bpred_select(const char *name) {
+  for (int i = 0; i < NR_BP_MODEL; i ++) {
+    if (strcmp(name, model_name[i]) != 0) continue;
+    if (bpred_model != BP_OFF) bpred_report();
+    reset();
+    bpred_model = i;
+    Log("Branch predictor: %s", model_name[i]);
+    return true;
+  }
+  return false;
+}
+
+static int stat_cmp(const void *a, const void *b) {
+  uint64_t x = ((BranchStat *)a)->miss, y = ((BranchStat *)b)->miss;
+  return (x < y) - (x > y);
+}
+
+static double rate(uint64_t miss, uint64_t exec) {
+  return (exec ? 100.0 * miss / exec : 0);
+}
+
+void bpred_report() {
+  if (bpred_model == BP_OFF) return;
+  uint64_t exec = 0, miss = 0;
+  for (int k = 0; k < NR_BP_KIND; k ++) {
+    exec += kind_exec[k];
+    miss += kind_miss[k];
+  }
+  Log("branch predictor %s: %" PRIu64 " control transfers, %" PRIu64 " mispredicted (%.2f%%)",
+      model_name[bpred_model], exec, miss, rate(miss, exec));
+  for (int k = 0; k < NR_BP_KIND; k ++) {
+    Log("  %-6s %14" PRIu64 " %14" PRIu64 " %6.2f%%", kind_name[k],
+        kind_exec[k], kind_miss[k], rate(kind_miss[k], kind_exec[k]));
+  }
+  if (nr_stat == 0) return;
+
+  BranchStat *e = malloc(sizeof(BranchStat) * nr_stat);
+  assert(e);
+  int n = 0;
+  for (uint32_t i = 0; i < stat_size; i ++) if (stat[i].exec && stat[i].miss) e[n ++] = stat[i];
+  qsort(e, n, sizeof(BranchStat), stat_cmp);
+  if (n > 0) Log("top branches by mispredictions:");
+  for (int i = 0; i < n && i < TOP_BRANCH; i ++) {
+    const ElfSym *sym = elf_lookup(e[i].pc);
+    char where[64] = "";
+    if (sym != NULL) snprintf(where, sizeof(where), "<%s+0x%x>", sym->name, (uint32_t)(e[i].pc - sym->start));
+    Log("  " FMT_WORD " %-24s %-6s %12" PRIu64 " %12" PRIu64 " %6.2f%%", e[i].pc, where,
+        kind_name[e[i].kind], e[i].exec, e[i].miss, rate(e[i].miss, e[i].exec));
+  }
+  free(e);
+}
@@ -0,0 +1,76 @@
+/***************************************************************************************
+* Copyright (c) 2014-2024 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#include <cpu/coverage.h>
+
+#define MAP_LEN ((COV_NR_SLOT + 7) / 8)
+
+uint8_t *cov_map[NR_COV_MAP] = {};
+static char *cov_file = NULL;
+
+typedef struct {
+  char magic[8];
+  uint32_t slot_shift, reserved;
+  uint64_t base, nr_slot;
+} CovHeader;
+
+static CovHeader header() {
+  CovHeader h = { .slot_shift = COV_SLOT_SHIFT, .base = CONFIG_MBASE, .nr_slot = COV_NR_SLOT };
+  memcpy(h.magic, "NEMUCOV1", 8);
+  return h;
+}
+
+// OR the bitmaps of previous runs into ours
+static void merge_old() {
+  FILE *fp = fopen(cov_file, "rb");
+  if (fp == NULL) return;
+  CovHeader h, my = header();
+  if (fread(&h, sizeof(h), 1, fp) != 1 || memcmp(&h, &my, sizeof(h)) != 0) {
+    Warn("%s has a different memory layout and is overwritten", cov_file);
+    fclose(fp);
+    return;
+  }
+  uint8_t *buf = malloc(MAP_LEN);
+  assert(buf);
+  for (int m = 0; m < NR_COV_MAP; m ++) {
+    if (fread(buf, MAP_LEN, 1, fp) != 1) break;
+    for (size_t i = 0; i < MAP_LEN; i ++) cov_map[m][i] |= buf[i];
+  }
+  free(buf);
+  fclose(fp);
+}
+
+void coverage_dump() {
+  if (cov_file == NULL) return;
+  merge_old();
+  FILE *fp = fopen(cov_file, "wb");
+  Assert(fp, "Can not open '%s'", cov_file);
+  CovHeader h = header();
+  fwrite(&h, sizeof(h), 1, fp);
+  for (int m = 0; m < NR_COV_MAP; m ++) fwrite(cov_map[m], MAP_LEN, 1, fp);
+  fclose(fp);
+  Log("Coverage is written to %s", cov_file);
+  cov_file = NULL;
+}
+
+void init_coverage(const char *file) {
+  if (file == NULL) return;
+  cov_file = strdup(file);
+  for (int m = 0; m < NR_COV_MAP; m ++) {
+    cov_map[m] = calloc(MAP_LEN, 1);
+    assert(cov_map[m]);
+  }
+  atexit(coverage_dump);
+}
@@ -0,0 +1,89 @@
+/***************************************************************************************
+* Copyright (c) 2014-2024 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#include <cpu/ftrace.h>
+#include <elf.h>
+
+// sorted by start address, so lookup is a binary search
+static ElfSym *syms = NULL;
+static int nr_sym = 0;
+
+int elf_nr_sym() { return nr_sym; }
+const ElfSym *elf_sym(int idx) { return &syms[idx]; }
+
+static int sym_cmp(const void *a, const void *b) {
+  vaddr_t x = ((ElfSym *)a)->start, y = ((ElfSym *)b)->start;
+  return (x > y) - (x < y);
+}
+
+// the section headers and symbols of ELF32 and ELF64 only differ in types
+#define LOAD_SYMTAB(Ehdr, Shdr, Sym, ST_TYPE) do { \
+  Ehdr *eh = (Ehdr *)buf; \
+  Assert(eh->e_shoff + eh->e_shnum * sizeof(Shdr) <= size, "corrupted ELF"); \
+  Shdr *sh = (Shdr *)(buf + eh->e_shoff); \
+  for (int i = 0; i < eh->e_shnum; i ++) { \
+    if (sh[i].sh_type != SHT_SYMTAB) continue; \
+    Sym *sym = (Sym *)(buf + sh[i].sh_offset); \
+    const char *strtab = (const char *)buf + sh[sh[i].sh_link].sh_offset; \
+    int n = sh[i].sh_size / sizeof(Sym); \
+    syms = realloc(syms, sizeof(ElfSym) * (nr_sym + n)); \
+    assert(syms); \
+    for (int j = 0; j < n; j ++) { \
+      if (ST_TYPE(sym[j].st_info) != STT_FUNC) continue; \
+      syms[nr_sym ++] = (ElfSym) { .start = sym[j].st_value, \
+        .end = sym[j].st_value + sym[j].st_size, .name = strdup(strtab + sym[j].st_name) }; \
+    } \
+  } \
+} while (0)
+
+void init_elf(const char *file) {
+  if (file == NULL) return;
+  FILE *fp = fopen(file, "rb");
+  Assert(fp, "Can not open '%s'", file);
+  fseek(fp, 0, SEEK_END);
+  long size = ftell(fp);
+  fseek(fp, 0, SEEK_SET);
+  uint8_t *buf = malloc(size);
+  assert(buf);
+  int ret = fread(buf, size, 1, fp);
+  assert(ret == 1);
+  fclose(fp);
+
+  Assert(size >= EI_NIDENT && memcmp(buf, ELFMAG, SELFMAG) == 0, "'%s' is not an ELF file", file);
+  if (buf[EI_CLASS] == ELFCLASS64) LOAD_SYMTAB(Elf64_Ehdr, Elf64_Shdr, Elf64_Sym, ELF64_ST_TYPE);
+  else LOAD_SYMTAB(Elf32_Ehdr, Elf32_Shdr, Elf32_Sym, ELF32_ST_TYPE);
+  free(buf);
+
+  qsort(syms, nr_sym, sizeof(ElfSym), sym_cmp);
+  // a symbol without size extends to the next one
+  for (int i = 0; i < nr_sym; i ++) {
+    if (syms[i].end == syms[i].start) {
+      syms[i].end = (i + 1 < nr_sym ? syms[i + 1].start : syms[i].start + 1);
+    }
+  }
+  Log("Read %d function symbols from %s", nr_sym, file);
+}
+
+const ElfSym *elf_lookup(vaddr_t addr) {
+  // find the last symbol starting at or below `addr'
+  int lo = 0, hi = nr_sym - 1, found = -1;
+  while (lo <= hi) {
+    int mid = (lo + hi) / 2;
+    if (syms[mid].start <= addr) { found = mid; lo = mid + 1; }
+    else hi = mid - 1;
+  }
+  if (found >= 0 && addr < syms[found].end) return &syms[found];
+  return NULL;
+}
@@ -13,8 +13,71 @@
 # See the Mulan PSL v2 for more details.
 #**************************************************************************************/
 
+ifndef CONFIG_ITRACE_BIN
+SRCS-BLACKLIST-y += src/utils/itrace.c
+endif
+
+ifeq ($(CONFIG_ITRACE_BIN)$(CONFIG_FTRACE),)
+SRCS-BLACKLIST-y += src/utils/tracefile.c
+endif
+
+ifndef CONFIG_FTRACE
+SRCS-BLACKLIST-y += src/utils/ftrace.c
+endif
+
+ifndef CONFIG_PROFILE
+SRCS-BLACKLIST-y += src/utils/profile.c
+endif
+
+ifndef CONFIG_INST_STAT
+SRCS-BLACKLIST-y += src/utils/inststat.c
+endif
+
+ifndef CONFIG_COVERAGE
+SRCS-BLACKLIST-y += src/utils/coverage.c
+endif
+
+ifndef CONFIG_REVERSE
+SRCS-BLACKLIST-y += src/utils/reverse.c
+endif
+
+ifndef CONFIG_TIMELINE
+SRCS-BLACKLIST-y += src/utils/timeline.c
+endif
+
+ifndef CONFIG_HOST_PROF
+SRCS-BLACKLIST-y += src/utils/hostprof.c
+endif
+
+ifndef CONFIG_PLUGIN
+SRCS-BLACKLIST-y += src/utils/plugin.c
+endif
+
+ifndef CONFIG_BPRED
+SRCS-BLACKLIST-y += src/utils/bpred.c
+endif
+
+ifndef CONFIG_PIPELINE
+SRCS-BLACKLIST-y += src/utils/pipeline.c
+endif
+
+ifndef CONFIG_TARGET_NATIVE_ELF
+SRCS-BLACKLIST-y += src/utils/elf.c
+endif
+
+ifndef CONFIG_IQUEUE
+SRCS-BLACKLIST-y += src/utils/iqueue.c
+endif
+
+ifndef CONFIG_LOG_ASYNC
+SRCS-BLACKLIST-y += src/utils/log-async.c
+endif
+
+# riscv has its own disassembler in src/isa/riscv32/disasm.c
 ifeq ($(CONFIG_ITRACE)$(CONFIG_IQUEUE),)
 SRCS-BLACKLIST-y += src/utils/disasm.c
+else ifdef CONFIG_ISA_riscv
+SRCS-BLACKLIST-y += src/utils/disasm.c
 else
 LIBCAPSTONE = tools/capstone/repo/libcapstone.so.5
 CFLAGS += -I tools/capstone/repo/include
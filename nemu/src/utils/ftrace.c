@@ -0,0 +1,98 @@
+/***************************************************************************************
+* Copyright (c) 2014-2024 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#include <cpu/ftrace.h>
+#include <cpu/itrace.h>
+
+#define BLOCK_NR_REC 4096
+// kind + pc delta + target delta + instruction count delta
+#define MAX_REC_LEN (1 + 10 + 10 + 10)
+
+extern uint64_t g_nr_guest_inst;
+
+FtraceFrame ftrace_stack[FTRACE_MAX_DEPTH];
+int ftrace_depth = 0;
+
+static TraceFile *trace_file = NULL;
+static uint8_t raw[BLOCK_NR_REC * MAX_REC_LEN];
+static uint8_t *raw_p = raw;
+static int nr_rec = 0;
+static vaddr_t last_pc = 0;
+static uint64_t last_inst = 0;
+
+static void flush_block() {
+  if (nr_rec == 0) return;
+  trace_file_write_block(trace_file, raw, raw_p - raw, nr_rec);
+  raw_p = raw;
+  nr_rec = 0;
+  last_pc = 0;
+  last_inst = 0;
+}
+
+static void write_rec(int kind, vaddr_t pc, vaddr_t target) {
+  if (trace_file == NULL) return;
+  uint8_t *p = raw_p;
+  *p ++ = kind;
+  p = put_varint(p, zigzag((sword_t)(pc - last_pc)));
+  p = put_varint(p, zigzag((sword_t)(target - pc)));
+  p = put_varint(p, g_nr_guest_inst - last_inst);
+  raw_p = p;
+  last_pc = pc;
+  last_inst = g_nr_guest_inst;
+  if (++ nr_rec == BLOCK_NR_REC) flush_block();
+}
+
+void ftrace_call(vaddr_t pc, vaddr_t target, vaddr_t ret_addr) {
+  if (ftrace_depth < FTRACE_MAX_DEPTH) {
+    ftrace_stack[ftrace_depth] = (FtraceFrame) { .func = target, .ret_addr = ret_addr };
+  }
+  ftrace_depth ++;
+  IFDEF(CONFIG_TIMELINE, timeline_guest(TL_GUEST_FUNC, 'B', NULL, target));
+  write_rec(FTRACE_CALL, pc, target);
+}
+
+void ftrace_ret(vaddr_t pc, vaddr_t target) {
+  // unwind to the frame returning to `target', which also handles longjmp()
+  int d = (ftrace_depth < FTRACE_MAX_DEPTH ? ftrace_depth : FTRACE_MAX_DEPTH);
+  while (d > 0 && ftrace_stack[d - 1].ret_addr != target) d --;
+  int new_depth = (d > 0 ? d - 1 : (ftrace_depth > 0 ? ftrace_depth - 1 : 0));
+  for (; ftrace_depth > new_depth; ftrace_depth --) {
+    IFDEF(CONFIG_TIMELINE, timeline_guest(TL_GUEST_FUNC, 'E', NULL, 0));
+  }
+  write_rec(FTRACE_RET, pc, target);
+}
+
+void ftrace_close() {
+  if (trace_file == NULL) return;
+  flush_block();
+  trace_file_flush(trace_file);
+}
+
+void init_ftrace(const char *file) {
+  if (file == NULL) return;
+  trace_file = trace_file_open(file, "NEMUFTR1", sizeof(raw));
+  int n = elf_nr_sym();
+  trace_file_write_u32(trace_file, n);
+  for (int i = 0; i < n; i ++) {
+    const ElfSym *sym = elf_sym(i);
+    uint64_t range[2] = { sym->start, sym->end };
+    uint32_t len = strlen(sym->name);
+    trace_file_write_raw(trace_file, range, sizeof(range));
+    trace_file_write_u32(trace_file, len);
+    trace_file_write_raw(trace_file, sym->name, len);
+  }
+  atexit(ftrace_close);
+  Log("Function trace is written to %s", file);
+}
@@ -0,0 +1,86 @@
+/***************************************************************************************
+* Copyright (c) 2014-2024 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#include <utils.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define UNIT "cycles"
+static inline uint64_t now() { return __rdtsc(); }
+#else
+#define UNIT "ns"
+static inline uint64_t now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+#endif
+
+static const char *phase_name[NR_HP] = {
+  [HP_LOOP] = "exec loop", [HP_FETCH] = "fetch", [HP_DECODE] = "decode",
+  [HP_EXEC] = "execute", [HP_MEM] = "memory", [HP_MMIO] = "mmio",
+  [HP_TRACE] = "trace", [HP_DIFFTEST] = "difftest", [HP_DEVICE] = "device_update",
+};
+
+bool hprof_sampling = false;
+int hprof_countdown = CONFIG_HOST_PROF_INTERVAL;
+
+// estimated total of each phase, sampled phases are scaled by the interval
+static uint64_t cost[NR_HP] = {};
+static uint64_t nr_sample = 0;
+
+#define MAX_NEST 16
+static int stack[MAX_NEST];
+static int depth = 0;
+static int cur = -1;
+static uint64_t last = 0;
+
+static void charge(uint64_t t) {
+  if (cur >= 0) cost[cur] += (t - last) * (hprof_sampling ? CONFIG_HOST_PROF_INTERVAL : 1);
+  last = t;
+}
+
+void hprof_enter(int phase) {
+  charge(now());
+  assert(depth < MAX_NEST);
+  stack[depth ++] = cur;
+  cur = phase;
+}
+
+void hprof_leave() {
+  charge(now());
+  cur = stack[-- depth];
+}
+
+void hprof_inst_end() {
+  if (!hprof_sampling) return;
+  hprof_leave();
+  hprof_sampling = false;
+  nr_sample ++;
+}
+
+void hprof_report() {
+  extern uint64_t g_nr_guest_inst;
+  uint64_t total = 0;
+  for (int i = 0; i < NR_HP; i ++) total += cost[i];
+  if (total == 0) return;
+  Log("host time of each phase (%" PRIu64 " instructions sampled, unit: " UNIT "):", nr_sample);
+  Log("  %-14s %16s %10s %7s", "phase", "total", "per inst", "share");
+  for (int i = 0; i < NR_HP; i ++) {
+    Log("  %-14s %16" PRIu64 " %10.2f %6.2f%%", phase_name[i], cost[i],
+        g_nr_guest_inst ? (double)cost[i] / g_nr_guest_inst : 0, 100.0 * cost[i] / total);
+  }
+}
@@ -0,0 +1,100 @@
+/***************************************************************************************
+* Copyright (c) 2014-2024 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#include <cpu/inststat.h>
+
+uint64_t *inst_stat_pc_cnt = NULL;
+static InstPatCount *pat_list = NULL; // patterns executed at least once
+static char *stat_file = NULL;
+
+void inst_stat_register(InstPatCount *c) {
+  c->next = pat_list;
+  pat_list = c;
+}
+
+typedef struct {
+  const char *name; // NULL for a pc
+  word_t pc;
+  uint64_t count;
+} StatEntry;
+
+static int entry_cmp(const void *a, const void *b) {
+  uint64_t x = ((StatEntry *)a)->count, y = ((StatEntry *)b)->count;
+  return (x < y) - (x > y);
+}
+
+// sorted by count in descending order
+static StatEntry *collect(bool is_pc, int *nr) {
+  int n = 0;
+  if (is_pc) {
+    for (word_t i = 0; i < INST_STAT_NR_PC; i ++) n += (inst_stat_pc_cnt[i] != 0);
+  } else {
+    for (InstPatCount *c = pat_list; c != NULL; c = c->next) n ++;
+  }
+  StatEntry *e = malloc(sizeof(StatEntry) * (n + 1));
+  assert(e);
+  n = 0;
+  if (is_pc) {
+    for (word_t i = 0; i < INST_STAT_NR_PC; i ++) {
+      if (inst_stat_pc_cnt[i] == 0) continue;
+      e[n ++] = (StatEntry) { .pc = CONFIG_MBASE + (i << 2), .count = inst_stat_pc_cnt[i] };
+    }
+  } else {
+    for (InstPatCount *c = pat_list; c != NULL; c = c->next) {
+      e[n ++] = (StatEntry) { .name = c->name, .count = c->count };
+    }
+  }
+  qsort(e, n, sizeof(StatEntry), entry_cmp);
+  *nr = n;
+  return e;
+}
+
+static void report(FILE *fp, bool is_pc, uint64_t total) {
+  int n;
+  StatEntry *e = collect(is_pc, &n);
+  Log("top %s by executed count:", is_pc ? "pcs" : "instructions");
+  for (int i = 0; i < n && i < CONFIG_INST_STAT_TOP; i ++) {
+    double ratio = (total ? 100.0 * e[i].count / total : 0);
+    if (is_pc) Log("  " FMT_WORD " %14" PRIu64 " %6.2f%%", e[i].pc, e[i].count, ratio);
+    else Log("  %-10s %14" PRIu64 " %6.2f%%", e[i].name, e[i].count, ratio);
+  }
+  for (int i = 0; fp != NULL && i < n; i ++) {
+    if (is_pc) fprintf(fp, "pc," FMT_WORD ",%" PRIu64 "\n", e[i].pc, e[i].count);
+    else fprintf(fp, "inst,%s,%" PRIu64 "\n", e[i].name, e[i].count);
+  }
+  free(e);
+}
+
+void inst_stat_report() {
+  if (inst_stat_pc_cnt == NULL) return;
+  uint64_t total = 0;
+  for (InstPatCount *c = pat_list; c != NULL; c = c->next) total += c->count;
+
+  FILE *fp = fopen(stat_file, "w");
+  if (fp == NULL) Warn("Can not open '%s'", stat_file);
+  else fprintf(fp, "kind,key,count\n");
+  report(fp, false, total);
+  report(fp, true, total);
+  if (fp != NULL) fclose(fp);
+}
+
+void init_inst_stat(const char *file) {
+  if (file == NULL) return;
+  stat_file = strdup(file);
+  // only the pages of executed code are touched
+  inst_stat_pc_cnt = calloc(INST_STAT_NR_PC, sizeof(uint64_t));
+  assert(inst_stat_pc_cnt);
+  Log("Instruction statistics are written to %s", file);
+}
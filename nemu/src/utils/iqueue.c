@@ -0,0 +1,41 @@
+/***************************************************************************************
+* Copyright (c) 2014-2024 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#include <cpu/itrace.h>
+
+MUXDEF(CONFIG_SMP_THREAD, __thread, ) IqueueRec iqueue[CONFIG_IQUEUE_SIZE];
+MUXDEF(CONFIG_SMP_THREAD, __thread, ) uint64_t iqueue_nr = 0;
+static MUXDEF(CONFIG_SMP_THREAD, __thread, ) uint64_t iqueue_dumped = 0;
+
+void disassemble(char *str, int size, uint64_t pc, uint8_t *code, int nbyte);
+
+// the records are only disassembled here, after something went wrong
+void iqueue_dump() {
+  if (iqueue_nr == 0 || iqueue_dumped == iqueue_nr) return;
+  iqueue_dumped = iqueue_nr;
+
+  extern FILE *log_fp;
+  FILE *fp = (log_fp != NULL ? log_fp : stdout);
+  log_flush();
+  uint64_t nr = (iqueue_nr < CONFIG_IQUEUE_SIZE ? iqueue_nr : CONFIG_IQUEUE_SIZE);
+  fprintf(fp, "Last %" PRIu64 " instructions executed:\n", nr);
+  for (uint64_t i = iqueue_nr - nr; i < iqueue_nr; i ++) {
+    IqueueRec *r = &iqueue[i & (CONFIG_IQUEUE_SIZE - 1)];
+    char buf[96];
+    disassemble(buf, sizeof(buf), r->pc, (uint8_t *)&r->inst, 4);
+    fprintf(fp, "%s " FMT_WORD ": %08x  %s\n", (i == iqueue_nr - 1 ? "-->" : "   "), r->pc, r->inst, buf);
+  }
+  fflush(fp);
+}
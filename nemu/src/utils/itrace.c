@@ -0,0 +1,65 @@
+/***************************************************************************************
+* Copyright (c) 2014-2024 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#include <cpu/itrace.h>
+
+// flags + pc delta + inst + rd + maddr
+#define MAX_REC_LEN (1 + 10 + 4 + 10 + 10)
+#define RAW_LEN (ITRACE_BLOCK_NR_REC * MAX_REC_LEN)
+
+ItraceRec *itrace_buf = NULL;
+int itrace_nr = 0;
+vaddr_t itrace_maddr = 0;
+bool itrace_has_maddr = false;
+
+static ItraceRec rec_buf[ITRACE_BLOCK_NR_REC];
+static uint8_t raw[RAW_LEN];
+static TraceFile *trace_file = NULL;
+
+void itrace_flush_block() {
+  if (itrace_nr == 0) return;
+  uint8_t *p = raw;
+  vaddr_t last_pc = 0, last_maddr = 0;
+  for (int i = 0; i < itrace_nr; i ++) {
+    ItraceRec *r = &rec_buf[i];
+    *p ++ = r->flags;
+    p = put_varint(p, zigzag((sword_t)(r->pc - last_pc)));
+    memcpy(p, &r->inst, 4);
+    p += 4;
+    if (r->flags & ITRACE_REC_RD) p = put_varint(p, r->rd_val);
+    if (r->flags & ITRACE_REC_MEM) {
+      p = put_varint(p, zigzag((sword_t)(r->maddr - last_maddr)));
+      last_maddr = r->maddr;
+    }
+    last_pc = r->pc;
+  }
+
+  trace_file_write_block(trace_file, raw, p - raw, itrace_nr);
+  itrace_nr = 0;
+}
+
+void itrace_close() {
+  if (trace_file == NULL) return;
+  itrace_flush_block();
+  trace_file_flush(trace_file);
+}
+
+void init_itrace(const char *file) {
+  if (file == NULL) return;
+  trace_file = trace_file_open(file, "NEMUITR1", RAW_LEN);
+  itrace_buf = rec_buf;
+  atexit(itrace_close);
+  Log("Binary instruction trace is written to %s", file);
+}
@@ -0,0 +1,125 @@
+/***************************************************************************************
+* Copyright (c) 2014-2024 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#include <common.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdarg.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+/* The thread running the guest formats the log records into a lock-free
+ * single-producer single-consumer ring, and a writer thread moves them to
+ * the log file with large writev() calls. When the ring is full, the
+ * producer waits for the writer, so the memory used is bounded.
+ */
+#define RING_SIZE CONFIG_LOG_ASYNC_BUF_SIZE
+#define RING_MASK (RING_SIZE - 1)
+static_assert((RING_SIZE & RING_MASK) == 0, "LOG_ASYNC_BUF_SIZE should be a power of 2");
+
+static char ring[RING_SIZE];
+static uint64_t head = 0; // only written by the producer
+static uint64_t tail = 0; // only written by the writer
+static int log_fd = -1;
+static pthread_t writer;
+
+static void *writer_main(void *arg) {
+  while (true) {
+    uint64_t h = __atomic_load_n(&head, __ATOMIC_ACQUIRE);
+    uint64_t t = tail;
+    if (h == t) {
+      usleep(1000);
+      continue;
+    }
+
+    size_t off = t & RING_MASK, len = h - t;
+    struct iovec iov[2] = { { .iov_base = ring + off, .iov_len = len } };
+    int n = 1;
+    if (off + len > RING_SIZE) {
+      iov[0].iov_len = RING_SIZE - off;
+      iov[1] = (struct iovec) { .iov_base = ring, .iov_len = len - iov[0].iov_len };
+      n = 2;
+    }
+    ssize_t ret = writev(log_fd, iov, n);
+    if (ret < 0) {
+      if (errno == EINTR) continue;
+      ret = len; // drop the records rather than blocking the guest forever
+    }
+    __atomic_store_n(&tail, t + ret, __ATOMIC_RELEASE);
+  }
+  return NULL;
+}
+
+static void ring_put(const char *buf, size_t len) {
+  while (len > 0) {
+    size_t room = RING_SIZE - (head - __atomic_load_n(&tail, __ATOMIC_ACQUIRE));
+    if (room == 0) {
+      sched_yield();
+      continue;
+    }
+    size_t n = (len < room ? len : room);
+    size_t off = head & RING_MASK;
+    size_t first = (off + n > RING_SIZE ? RING_SIZE - off : n);
+    memcpy(ring + off, buf, first);
+    memcpy(ring, buf + first, n - first);
+    __atomic_store_n(&head, head + n, __ATOMIC_RELEASE);
+    buf += n;
+    len -= n;
+  }
+}
+
+void log_write_async(const char *fmt, ...) {
+  extern FILE *log_fp;
+  va_list ap;
+  va_start(ap, fmt);
+  if (log_fd < 0) {
+    vfprintf(log_fp, fmt, ap);
+    va_end(ap);
+    return;
+  }
+
+  char buf[512];
+  va_list ap2;
+  va_copy(ap2, ap);
+  int ret = vsnprintf(buf, sizeof(buf), fmt, ap);
+  if (ret >= 0) { // nothing is logged on an encoding error
+    size_t len = ret;
+    if (len < sizeof(buf)) {
+      ring_put(buf, len);
+    } else {
+      char *p = malloc(len + 1);
+      vsnprintf(p, len + 1, fmt, ap2);
+      ring_put(p, len);
+      free(p);
+    }
+  }
+  va_end(ap2);
+  va_end(ap);
+}
+
+// wait until the writer has written everything in the ring
+void log_drain() {
+  if (log_fd < 0) return;
+  while (__atomic_load_n(&tail, __ATOMIC_ACQUIRE) != head) sched_yield();
+}
+
+void init_log_async(FILE *fp) {
+  fflush(fp);
+  log_fd = fileno(fp);
+  int ret = pthread_create(&writer, NULL, writer_main, NULL);
+  Assert(ret == 0, "Can not create the log writer thread");
+  pthread_detach(writer);
+}
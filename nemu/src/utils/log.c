@@ -15,19 +15,64 @@
 
 #include <common.h>
 
-extern uint64_t g_nr_guest_inst;
+extern MUXDEF(CONFIG_SMP_THREAD, __thread, ) uint64_t g_nr_guest_inst;
+
+int log_level = LOG_LV_INFO;
+uint32_t log_debug_mods = MUXDEF(CONFIG_LOG_LEVEL_DEBUG, (1u << NR_LOG_MOD) - 1, 0);
 
 #ifndef CONFIG_TARGET_AM
+static const char *log_mod_name[NR_LOG_MOD] = {
+  [LOG_ISA] = "isa", [LOG_CPU] = "cpu", [LOG_MEM] = "mem", [LOG_DEV] = "dev", [LOG_SDB] = "sdb",
+};
+
+void log_set_level(int level) {
+  log_level = level;
+  if (level < LOG_LV_DEBUG) log_debug_mods = 0;
+}
+
+// `mods' is a comma-separated list of module names, or "all"
+void log_set_debug(const char *mods) {
+  log_level = LOG_LV_DEBUG;
+  log_debug_mods = 0;
+  char buf[128];
+  strncpy(buf, mods, sizeof(buf) - 1);
+  buf[sizeof(buf) - 1] = '\0';
+  for (char *m = strtok(buf, ","); m != NULL; m = strtok(NULL, ",")) {
+    bool found = false;
+    for (int i = 0; i < NR_LOG_MOD; i ++) {
+      if (strcmp(m, "all") == 0 || strcmp(m, log_mod_name[i]) == 0) {
+        log_debug_mods |= 1u << i;
+        found = true;
+      }
+    }
+    if (!found) Warn("unknown log module '%s'", m);
+  }
+}
+
 FILE *log_fp = NULL;
+static char log_buf[64 * 1024];
 
 void init_log(const char *log_file) {
   log_fp = stdout;
   if (log_file != NULL) {
     FILE *fp = fopen(log_file, "w");
     Assert(fp, "Can not open '%s'", log_file);
+    setvbuf(fp, log_buf, _IOFBF, sizeof(log_buf));
     log_fp = fp;
   }
   Log("Log is written to %s", log_file ? log_file : "stdout");
+#ifdef CONFIG_LOG_ASYNC
+  // records written to stdout have to stay in order with printf()
+  void init_log_async(FILE *fp);
+  if (log_fp != stdout) init_log_async(log_fp);
+#endif
+  atexit(log_flush);
+}
+
+void log_flush() {
+  if (log_fp == NULL) return;
+  IFDEF(CONFIG_LOG_ASYNC, void log_drain(); log_drain());
+  fflush(log_fp);
 }
 
 bool log_enable() {
@@ -0,0 +1,112 @@
+/***************************************************************************************
+* Copyright (c) 2014-2024 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#include <cpu/pipeline.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+#define RING_SIZE CONFIG_PIPELINE_RING_SIZE
+#define RING_MASK (RING_SIZE - 1)
+static_assert((RING_SIZE & RING_MASK) == 0, "PIPELINE_RING_SIZE should be a power of 2");
+static_assert(RING_SIZE >= PIPE_BATCH, "PIPELINE_RING_SIZE should hold a batch");
+
+#define MAX_CONSUMER 8
+
+typedef struct {
+  const char *name;
+  pipe_consumer_t fn;
+  void *arg;
+  bool drop;
+  PipeEvent *ring;
+  uint64_t head;    // only written by the producer
+  uint64_t tail;    // only written by the consumer
+  uint64_t dropped; // events dropped since the ring was full
+  pthread_t thread;
+} Consumer;
+
+bool pipeline_on = false;
+PipeEvent pipe_batch[PIPE_BATCH];
+int pipe_nr = 0;
+
+static Consumer consumers[MAX_CONSUMER];
+static int nr_consumer = 0;
+static bool stopping = false;
+
+static void *consumer_main(void *arg) {
+  Consumer *c = arg;
+  while (true) {
+    uint64_t h = __atomic_load_n(&c->head, __ATOMIC_ACQUIRE);
+    uint64_t t = c->tail;
+    if (h == t) {
+      if (__atomic_load_n(&stopping, __ATOMIC_ACQUIRE) &&
+          __atomic_load_n(&c->head, __ATOMIC_ACQUIRE) == t) break;
+      usleep(100);
+      continue;
+    }
+    // process the contiguous part of the ring in one call
+    uint64_t off = t & RING_MASK, n = h - t;
+    if (off + n > RING_SIZE) n = RING_SIZE - off;
+    c->fn(c->arg, &c->ring[off], n);
+    __atomic_store_n(&c->tail, t + n, __ATOMIC_RELEASE);
+  }
+  return NULL;
+}
+
+static void put_batch(Consumer *c) {
+  while (RING_SIZE - (c->head - __atomic_load_n(&c->tail, __ATOMIC_ACQUIRE)) < pipe_nr) {
+    if (c->drop) {
+      c->dropped += pipe_nr;
+      return;
+    }
+    sched_yield();
+  }
+  uint64_t off = c->head & RING_MASK;
+  int first = (off + pipe_nr > RING_SIZE ? RING_SIZE - off : pipe_nr);
+  memcpy(&c->ring[off], pipe_batch, sizeof(PipeEvent) * first);
+  memcpy(c->ring, pipe_batch + first, sizeof(PipeEvent) * (pipe_nr - first));
+  __atomic_store_n(&c->head, c->head + pipe_nr, __ATOMIC_RELEASE);
+}
+
+void pipeline_publish() {
+  for (int i = 0; i < nr_consumer; i ++) put_batch(&consumers[i]);
+  pipe_nr = 0;
+}
+
+void pipeline_add_consumer(const char *name, pipe_consumer_t fn, void *arg, bool drop) {
+  Assert(nr_consumer < MAX_CONSUMER, "Too many consumers of the analysis pipeline");
+  Consumer *c = &consumers[nr_consumer];
+  *c = (Consumer) { .name = name, .fn = fn, .arg = arg, .drop = drop };
+  c->ring = malloc(sizeof(PipeEvent) * RING_SIZE);
+  assert(c->ring);
+  int ret = pthread_create(&c->thread, NULL, consumer_main, c);
+  Assert(ret == 0, "Can not create the thread of consumer %s", name);
+  if (nr_consumer ++ == 0) atexit(pipeline_close);
+  pipeline_on = true;
+  Log("Consumer %s of the analysis pipeline is started (%s when full)", name, drop ? "drop" : "block");
+}
+
+// deliver the remaining events and wait for the consumers to finish
+void pipeline_close() {
+  if (!pipeline_on) return;
+  pipeline_on = false;
+  if (pipe_nr > 0) pipeline_publish();
+  __atomic_store_n(&stopping, true, __ATOMIC_RELEASE);
+  for (int i = 0; i < nr_consumer; i ++) {
+    Consumer *c = &consumers[i];
+    pthread_join(c->thread, NULL);
+    if (c->dropped) Warn("%" PRIu64 " events are dropped for consumer %s", c->dropped, c->name);
+  }
+}
@@ -0,0 +1,116 @@
+/***************************************************************************************
+* Copyright (c) 2014-2024 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#include <cpu/plugin.h>
+#include <nemu-plugin.h>
+#include <cpu/pipeline.h>
+#include <dlfcn.h>
+
+#define MAX_PLUGIN 8
+
+bool plugin_on[NR_PLUGIN_EV] = {};
+static NemuPluginCallbacks plugins[MAX_PLUGIN];
+static int nr_plugin = 0;
+
+#define for_each_plugin(field, ...) \
+  for (int i = 0; i < nr_plugin; i ++) { \
+    NemuPluginCallbacks *p = &plugins[i]; \
+    if (p->field) p->field(p->udata, ## __VA_ARGS__); \
+  }
+
+void plugin_block_exec(vaddr_t pc, uint64_t nr_inst) {
+  for_each_plugin(block_exec, pc, nr_inst);
+}
+
+void plugin_inst_exec(vaddr_t pc, uint32_t inst) {
+  for_each_plugin(inst_exec, pc, inst);
+}
+
+void plugin_mem_access(vaddr_t addr, int len, bool is_write, word_t data) {
+  for_each_plugin(mem_access, addr, len, is_write, data);
+}
+
+void plugin_mmio_access(const char *dev, paddr_t addr, int len, bool is_write, word_t data) {
+  for_each_plugin(mmio_access, dev, addr, len, is_write, data);
+}
+
+void plugin_trap(vaddr_t epc, word_t cause) {
+  for_each_plugin(trap, epc, cause);
+}
+
+#ifdef CONFIG_PIPELINE
+// runs on the consumer thread of the pipeline
+static void plugin_async(void *arg, const PipeEvent *ev, int nr) {
+  NemuPluginCallbacks *p = arg;
+  NemuPluginEvent buf[256];
+  while (nr > 0) {
+    int n = (nr < ARRLEN(buf) ? nr : ARRLEN(buf));
+    for (int i = 0; i < n; i ++) {
+      buf[i] = (NemuPluginEvent) { .kind = ev[i].kind, .len = ev[i].len, .taken = ev[i].taken,
+        .pc = ev[i].pc, .addr = ev[i].addr };
+    }
+    p->async_events(p->udata, buf, n);
+    ev += n;
+    nr -= n;
+  }
+}
+#endif
+
+static void plugin_exit() {
+  IFDEF(CONFIG_PIPELINE, pipeline_close());
+  for_each_plugin(exit);
+}
+
+// `spec' is "FILE" or "FILE,ARGS"
+void load_plugin(const char *spec) {
+  Assert(nr_plugin < MAX_PLUGIN, "Too many plugins");
+  char *file = strdup(spec);
+  char *args = strchr(file, ',');
+  if (args != NULL) *args ++ = '\0';
+
+  void *handle = dlopen(file, RTLD_NOW | RTLD_LOCAL);
+  Assert(handle, "%s", dlerror());
+  nemu_plugin_install_t install = (nemu_plugin_install_t)dlsym(handle, "nemu_plugin_install");
+  Assert(install, "%s does not export nemu_plugin_install()", file);
+
+  NemuPluginCallbacks *p = &plugins[nr_plugin];
+  memset(p, 0, sizeof(*p));
+  p->version = NEMU_PLUGIN_VERSION;
+  p->size = sizeof(*p);
+  int ret = install(args ? args : "", p);
+  if (ret != 0) {
+    Warn("Plugin %s refuses to be loaded, ret = %d", file, ret);
+    dlclose(handle);
+    free(file);
+    return;
+  }
+  nr_plugin ++;
+
+  plugin_on[PLUGIN_EV_BLOCK] |= (p->block_exec != NULL);
+  plugin_on[PLUGIN_EV_INST]  |= (p->inst_exec != NULL);
+  plugin_on[PLUGIN_EV_MEM]   |= (p->mem_access != NULL);
+  plugin_on[PLUGIN_EV_MMIO]  |= (p->mmio_access != NULL);
+  plugin_on[PLUGIN_EV_TRAP]  |= (p->trap != NULL);
+  if (p->async_events != NULL) {
+#ifdef CONFIG_PIPELINE
+    pipeline_add_consumer(strdup(file), plugin_async, p, p->async_drop);
+#else
+    Warn("Asynchronous events of plugin %s are ignored without CONFIG_PIPELINE", file);
+#endif
+  }
+  if (nr_plugin == 1) atexit(plugin_exit);
+  Log("Plugin %s is loaded", file);
+  free(file);
+}
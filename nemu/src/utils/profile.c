@@ -0,0 +1,133 @@
+/***************************************************************************************
+* Copyright (c) 2014-2024 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#include <isa.h>
+#include <cpu/ftrace.h>
+#include <cpu/profile.h>
+
+extern uint64_t g_nr_guest_inst;
+
+// never sample until a profile is requested
+uint64_t profile_next = UINT64_MAX;
+
+typedef struct {
+  uint64_t hash;
+  uint64_t count;
+  int depth;
+  vaddr_t *frames; // function entries from the outermost one
+} Stack;
+
+static Stack *table = NULL;
+static uint32_t table_size = 0; // a power of 2
+static uint32_t nr_stack = 0;
+static uint64_t nr_sample = 0;
+static char *profile_file = NULL;
+
+static uint64_t hash_frames(const vaddr_t *frames, int depth) {
+  uint64_t h = 0xcbf29ce484222325ull; // FNV-1a
+  for (int i = 0; i < depth; i ++) {
+    h ^= frames[i];
+    h *= 0x100000001b3ull;
+  }
+  return h;
+}
+
+static Stack *find_slot(Stack *t, uint32_t size, uint64_t h, const vaddr_t *frames, int depth) {
+  for (uint32_t i = h & (size - 1); ; i = (i + 1) & (size - 1)) {
+    Stack *e = &t[i];
+    if (e->frames == NULL) return e;
+    if (e->hash == h && e->depth == depth &&
+        memcmp(e->frames, frames, sizeof(vaddr_t) * depth) == 0) return e;
+  }
+}
+
+static void grow() {
+  uint32_t new_size = table_size * 2;
+  Stack *t = calloc(new_size, sizeof(Stack));
+  assert(t);
+  for (uint32_t i = 0; i < table_size; i ++) {
+    if (table[i].frames != NULL) *find_slot(t, new_size, table[i].hash, NULL, -1) = table[i];
+  }
+  free(table);
+  table = t;
+  table_size = new_size;
+}
+
+// samples of the same function are merged no matter where in it the pc is
+static vaddr_t func_of(vaddr_t addr) {
+  const ElfSym *sym = elf_lookup(addr);
+  return (sym ? sym->start : addr);
+}
+
+void profile_sample() {
+  static vaddr_t frames[FTRACE_MAX_DEPTH + 2];
+  int n = (ftrace_depth < FTRACE_MAX_DEPTH ? ftrace_depth : FTRACE_MAX_DEPTH);
+  int depth = 0;
+  // the function which made the outermost traced call
+  if (n > 0) frames[depth ++] = func_of(ftrace_stack[0].ret_addr - 4);
+  for (int i = 0; i < n; i ++) frames[depth ++] = ftrace_stack[i].func;
+  vaddr_t leaf = func_of(cpu.pc);
+  if (depth == 0 || frames[depth - 1] != leaf) frames[depth ++] = leaf;
+
+  uint64_t h = hash_frames(frames, depth);
+  Stack *e = find_slot(table, table_size, h, frames, depth);
+  if (e->frames == NULL) {
+    e->hash = h;
+    e->depth = depth;
+    e->frames = malloc(sizeof(vaddr_t) * depth);
+    assert(e->frames);
+    memcpy(e->frames, frames, sizeof(vaddr_t) * depth);
+    if (++ nr_stack * 2 > table_size) grow();
+    e = find_slot(table, table_size, h, frames, depth);
+  }
+  e->count ++;
+  nr_sample ++;
+  profile_next = g_nr_guest_inst + CONFIG_PROFILE_INTERVAL;
+}
+
+static void print_frame(FILE *fp, vaddr_t addr) {
+  const ElfSym *sym = elf_lookup(addr);
+  if (sym) fputs(sym->name, fp);
+  else fprintf(fp, FMT_WORD, addr);
+}
+
+void profile_dump() {
+  if (profile_file == NULL) return;
+  FILE *fp = fopen(profile_file, "w");
+  Assert(fp, "Can not open '%s'", profile_file);
+  for (uint32_t i = 0; i < table_size; i ++) {
+    Stack *e = &table[i];
+    if (e->frames == NULL) continue;
+    for (int j = 0; j < e->depth; j ++) {
+      if (j > 0) fputc(';', fp);
+      print_frame(fp, e->frames[j]);
+    }
+    fprintf(fp, " %" PRIu64 "\n", e->count);
+  }
+  fclose(fp);
+  Log("%" PRIu64 " samples of %u distinct stacks are written to %s", nr_sample, nr_stack, profile_file);
+  profile_file = NULL;
+}
+
+void init_profile(const char *file) {
+  if (file == NULL) return;
+  profile_file = strdup(file);
+  table_size = 1024;
+  table = calloc(table_size, sizeof(Stack));
+  assert(table);
+  profile_next = g_nr_guest_inst + CONFIG_PROFILE_INTERVAL;
+  atexit(profile_dump);
+  Log("Sampling profile is written to %s", file);
+}
@@ -0,0 +1,289 @@
+/***************************************************************************************
+* Copyright (c) 2014-2024 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#include <isa.h>
+#include <cpu/cpu.h>
+#include <cpu/reverse.h>
+#include <memory/paddr.h>
+#include "../monitor/sdb/sdb.h"
+
+/* Checkpoint k holds the old contents of the pages first written between
+ * checkpoint k and k + 1 (or now for the newest one). To go back to
+ * checkpoint k, the saved pages are copied back from the newest checkpoint
+ * down to k, so every page ends up with its content at checkpoint k.
+ */
+typedef struct {
+  uint64_t nr_inst;
+  CPU_state cpu;
+  size_t input_pos, intr_pos; // positions in the logs
+  int nr_page, max_page;
+  paddr_t *page;              // page numbers
+  uint8_t *data;              // the old contents of the pages
+} Ckpt;
+
+static Ckpt ckpt[CONFIG_REVERSE_MAX_CKPT];
+static int nr_ckpt = 0;
+static uint64_t saved_bytes = 0;
+
+int rev_mode = REV_LIVE;
+uint8_t rev_page_saved[REV_NR_PAGE / 8] = {};
+uint64_t rev_next = 0;
+
+/* Logs of the inputs from outside of the guest. Positions are counted
+ * from the start of NEMU, and `base' is the position of the first entry
+ * still kept.
+ */
+typedef struct {
+  uint64_t nr_inst;
+  uint32_t lines;
+} IntrEvent;
+
+static uint64_t *input = NULL;
+static size_t input_base = 0, nr_input = 0, max_input = 0, input_pos = 0;
+static IntrEvent *intr_ev = NULL;
+static size_t intr_base = 0, nr_intr = 0, max_intr = 0, intr_pos = 0;
+static uint32_t cur_lines = 0;
+
+extern uint64_t g_nr_guest_inst;
+
+#define grow(buf, max, n) do { \
+    if ((n) == (max)) { \
+      (max) = ((max) == 0 ? 1024 : (max) * 2); \
+      (buf) = realloc((buf), sizeof(*(buf)) * (max)); \
+      assert(buf); \
+    } \
+  } while (0)
+
+uint64_t rev_record(uint64_t val) {
+  // e.g. MMIO read by the monitor
+  if (nemu_state.state != NEMU_RUNNING) return val;
+  grow(input, max_input, nr_input);
+  input[nr_input ++] = val;
+  return val;
+}
+
+uint64_t rev_replay() {
+  Assert(input_pos < input_base + nr_input, "replay runs out of the recorded inputs at pc = " FMT_WORD, cpu.pc);
+  return input[input_pos ++ - input_base];
+}
+
+uint32_t rev_intr_lines(uint32_t lines) {
+  if (rev_mode == REV_LIVE) cur_lines = lines;
+  return cur_lines;
+}
+
+/* Only the block boundaries where interrupt lines are fetched or an
+ * interrupt is taken are recorded. The replay stops at each of them, and
+ * does not query interrupts at any other boundary.
+ */
+word_t rev_query_intr() {
+  if (rev_mode == REV_LIVE) {
+    cur_lines = 0;
+    word_t intr = isa_query_intr();
+    if (cur_lines != 0 || intr != INTR_EMPTY) {
+      grow(intr_ev, max_intr, nr_intr);
+      intr_ev[nr_intr ++] = (IntrEvent) { .nr_inst = g_nr_guest_inst, .lines = cur_lines };
+    }
+    return intr;
+  }
+  if (intr_pos == intr_base + nr_intr || intr_ev[intr_pos - intr_base].nr_inst != g_nr_guest_inst) {
+    return INTR_EMPTY;
+  }
+  cur_lines = intr_ev[intr_pos ++ - intr_base].lines;
+  return isa_query_intr();
+}
+
+static void ckpt_add_page(Ckpt *c, paddr_t pg, uint8_t *src) {
+  if (c->nr_page == c->max_page) {
+    c->max_page = (c->max_page == 0 ? 16 : c->max_page * 2);
+    c->page = realloc(c->page, sizeof(paddr_t) * c->max_page);
+    c->data = realloc(c->data, PAGE_SIZE * c->max_page);
+    assert(c->page && c->data);
+  }
+  c->page[c->nr_page] = pg;
+  memcpy(c->data + PAGE_SIZE * c->nr_page, src, PAGE_SIZE);
+  c->nr_page ++;
+  saved_bytes += PAGE_SIZE;
+}
+
+static void ckpt_free(Ckpt *c) {
+  saved_bytes -= (uint64_t)PAGE_SIZE * c->nr_page;
+  free(c->page);
+  free(c->data);
+}
+
+void rev_save_page(paddr_t pg) {
+  // the pages written by the replay have been saved by the live run
+  if (rev_mode != REV_LIVE || nr_ckpt == 0) return;
+  ckpt_add_page(&ckpt[nr_ckpt - 1], pg, guest_to_host(CONFIG_MBASE + (pg << PAGE_SHIFT)));
+  rev_page_saved[pg >> 3] |= 1 << (pg & 7);
+}
+
+// drop checkpoint `j' by merging its pages into checkpoint `j - 1'
+static void merge_ckpt(int j) {
+  static uint8_t in_prev[REV_NR_PAGE / 8];
+  Ckpt *prev = &ckpt[j - 1], *c = &ckpt[j];
+  memset(in_prev, 0, sizeof(in_prev));
+  for (int i = 0; i < prev->nr_page; i ++) in_prev[prev->page[i] >> 3] |= 1 << (prev->page[i] & 7);
+  for (int i = 0; i < c->nr_page; i ++) {
+    paddr_t pg = c->page[i];
+    // the page is not written between the two checkpoints, so its content
+    // at checkpoint `j' is also the one at checkpoint `j - 1'
+    if (!((in_prev[pg >> 3] >> (pg & 7)) & 1)) ckpt_add_page(prev, pg, c->data + PAGE_SIZE * i);
+  }
+  ckpt_free(c);
+  memmove(&ckpt[j], &ckpt[j + 1], sizeof(Ckpt) * (nr_ckpt - j - 1));
+  nr_ckpt --;
+}
+
+// going back to before the oldest checkpoint is no longer possible
+static void drop_oldest() {
+  ckpt_free(&ckpt[0]);
+  memmove(&ckpt[0], &ckpt[1], sizeof(Ckpt) * (nr_ckpt - 1));
+  nr_ckpt --;
+  size_t n = ckpt[0].input_pos - input_base;
+  memmove(input, input + n, sizeof(*input) * (nr_input - n));
+  nr_input -= n;
+  input_base += n;
+  n = ckpt[0].intr_pos - intr_base;
+  memmove(intr_ev, intr_ev + n, sizeof(*intr_ev) * (nr_intr - n));
+  nr_intr -= n;
+  intr_base += n;
+}
+
+// the logs count as well, a guest polling a device fills them without writing pages
+static uint64_t used_bytes() {
+  return saved_bytes + sizeof(*input) * nr_input + sizeof(*intr_ev) * nr_intr;
+}
+
+/* Thin out the checkpoints exponentially: drop the one whose removal
+ * leaves the smallest gap compared with its age, so the gaps grow in
+ * proportion to the distance from now. The oldest and the newest ones
+ * are always kept.
+ */
+static void thin_ckpt(uint64_t now) {
+  int victim = 1;
+  double best = 0;
+  for (int j = 1; j < nr_ckpt - 1; j ++) {
+    double cost = (double)(ckpt[j + 1].nr_inst - ckpt[j - 1].nr_inst) / (now - ckpt[j].nr_inst);
+    if (j == 1 || cost < best) { best = cost; victim = j; }
+  }
+  merge_ckpt(victim);
+}
+
+void rev_take_ckpt(uint64_t nr_inst) {
+  if (nr_ckpt == CONFIG_REVERSE_MAX_CKPT) thin_ckpt(nr_inst);
+  while (nr_ckpt > 1 && used_bytes() > (uint64_t)CONFIG_REVERSE_MAX_MB * 1024 * 1024) drop_oldest();
+  ckpt[nr_ckpt ++] = (Ckpt) { .nr_inst = nr_inst, .cpu = cpu,
+    .input_pos = input_base + nr_input, .intr_pos = intr_base + nr_intr };
+  memset(rev_page_saved, 0, sizeof(rev_page_saved));
+  rev_next = nr_inst + CONFIG_REVERSE_INTERVAL;
+}
+
+static void restore(int k) {
+  for (int j = nr_ckpt - 1; j >= k; j --) {
+    Ckpt *c = &ckpt[j];
+    for (int i = 0; i < c->nr_page; i ++) {
+      memcpy(guest_to_host(CONFIG_MBASE + (c->page[i] << PAGE_SHIFT)), c->data + PAGE_SIZE * i, PAGE_SIZE);
+    }
+  }
+  cpu = ckpt[k].cpu;
+  cpu_set_inst_count(ckpt[k].nr_inst);
+  input_pos = ckpt[k].input_pos;
+  intr_pos = ckpt[k].intr_pos;
+  nemu_state.state = NEMU_STOP;
+}
+
+/* Re-execute up to `target'. Interrupts are only taken at block
+ * boundaries, so the replay stops at each recorded one. Return the last
+ * instruction count where a breakpoint is hit in REV_SEARCH mode.
+ */
+static uint64_t replay(uint64_t target, int mode) {
+  uint64_t last = UINT64_MAX;
+  bool at_bp = false;
+  rev_mode = mode;
+  rev_next = UINT64_MAX;
+  while (g_nr_guest_inst < target) {
+    if (mode == REV_SEARCH && !at_bp && nr_bp > 0) {
+      // cpu_exec() never stops at the instruction where it starts
+      bp_start_inst = UINT64_MAX;
+      if (bp_hit(cpu.pc, g_nr_guest_inst)) last = g_nr_guest_inst;
+    }
+    uint64_t next = target;
+    if (intr_pos < intr_base + nr_intr && intr_ev[intr_pos - intr_base].nr_inst < target) {
+      next = intr_ev[intr_pos - intr_base].nr_inst;
+      Assert(next > g_nr_guest_inst, "interrupt at instruction %" PRIu64 " is missed in the replay", next);
+    }
+    cpu_exec(next - g_nr_guest_inst);
+    if (nemu_state.state == NEMU_END || nemu_state.state == NEMU_ABORT || nemu_state.state == NEMU_QUIT) break;
+    at_bp = (g_nr_guest_inst < next); // stopped by a breakpoint
+    if (at_bp) last = g_nr_guest_inst;
+  }
+  rev_mode = REV_LIVE;
+  return last;
+}
+
+// forget the future after going back, it is recorded again from now on
+static void finish() {
+  while (ckpt[nr_ckpt - 1].nr_inst > g_nr_guest_inst) ckpt_free(&ckpt[-- nr_ckpt]);
+  nr_input = input_pos - input_base;
+  nr_intr = intr_pos - intr_base;
+  Ckpt *c = &ckpt[nr_ckpt - 1];
+  memset(rev_page_saved, 0, sizeof(rev_page_saved));
+  for (int i = 0; i < c->nr_page; i ++) rev_page_saved[c->page[i] >> 3] |= 1 << (c->page[i] & 7);
+  rev_next = c->nr_inst + CONFIG_REVERSE_INTERVAL;
+  if (nemu_state.state == NEMU_RUNNING) nemu_state.state = NEMU_STOP;
+}
+
+bool rev_step(uint64_t n) {
+  if (nr_ckpt == 0) {
+    printf("No checkpoint is taken yet\n");
+    return false;
+  }
+  uint64_t now = g_nr_guest_inst, oldest = ckpt[0].nr_inst;
+  uint64_t target = (now - oldest < n ? oldest : now - n);
+  if (target != now - n) printf("Can only go back to the oldest checkpoint at instruction %" PRIu64 "\n", oldest);
+  int k = nr_ckpt - 1;
+  while (ckpt[k].nr_inst > target) k --;
+  restore(k);
+  replay(target, REV_REPLAY);
+  finish();
+  return true;
+}
+
+// go back to the last breakpoint hit, searching one checkpoint after another
+bool rev_continue() {
+  if (nr_ckpt == 0) {
+    printf("No checkpoint is taken yet\n");
+    return false;
+  }
+  uint64_t end = g_nr_guest_inst;
+  for (int k = nr_ckpt - 1; k >= 0 && nr_bp > 0; k --) {
+    if (ckpt[k].nr_inst >= end) continue;
+    restore(k);
+    uint64_t last = replay(end, REV_SEARCH);
+    if (last != UINT64_MAX) {
+      restore(k);
+      replay(last, REV_REPLAY);
+      finish();
+      return true;
+    }
+    end = ckpt[k].nr_inst;
+  }
+  printf("No breakpoint is hit, going back to the oldest checkpoint at instruction %" PRIu64 "\n", ckpt[0].nr_inst);
+  restore(0);
+  finish();
+  return true;
+}
@@ -0,0 +1,161 @@
+/***************************************************************************************
+* Copyright (c) 2014-2024 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#include <utils.h>
+#include <cpu/cpu.h>
+#include <cpu/ftrace.h>
+#include <pthread.h>
+
+/* Each host thread fills its own buffer of raw events. Full buffers are
+ * queued to a writer thread, which formats them as trace-event JSON, so
+ * neither the formatting nor the file I/O is done by the guest.
+ */
+#define BUF_NR_EVENT 4096
+
+typedef struct {
+  uint8_t kind;
+  char ph;
+  uint16_t tid;
+  const char *name;
+  uint64_t ts, dur, arg;
+} TlEvent;
+
+typedef struct TlBuf {
+  int nr;
+  struct TlBuf *next;
+  TlEvent ev[BUF_NR_EVENT];
+} TlBuf;
+
+extern MUXDEF(CONFIG_SMP_THREAD, __thread, ) uint64_t g_nr_guest_inst;
+
+bool timeline_on = false;
+static FILE *tl_fp = NULL;
+static bool first_event = true;
+static MUXDEF(CONFIG_SMP_THREAD, __thread, ) TlBuf *cur_buf = NULL;
+
+static pthread_mutex_t queue_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queue_cond = PTHREAD_COND_INITIALIZER;
+static TlBuf *queue_head = NULL, *queue_tail = NULL;
+static bool writer_exit = false;
+static pthread_t writer;
+
+enum { PID_GUEST, PID_HOST };
+
+static void write_event(const TlEvent *e) {
+  fputs(first_event ? "\n" : ",\n", tl_fp);
+  first_event = false;
+  int pid = (e->kind == TL_HOST ? PID_HOST : PID_GUEST);
+  fprintf(tl_fp, "{\"ph\":\"%c\",\"pid\":%d,\"tid\":%d,\"ts\":%" PRIu64, e->ph, pid, e->tid, e->ts);
+  switch (e->kind) {
+    case TL_GUEST_FUNC: {
+      if (e->ph == 'E') break; // matched with the last 'B'
+      const ElfSym *sym = elf_lookup(e->arg);
+      if (sym) fprintf(tl_fp, ",\"cat\":\"func\",\"name\":\"%s\"", sym->name);
+      else fprintf(tl_fp, ",\"cat\":\"func\",\"name\":\"" FMT_WORD "\"", (word_t)e->arg);
+      break;
+    }
+    case TL_GUEST_MMIO:
+      fprintf(tl_fp, ",\"cat\":\"mmio\",\"name\":\"%s\",\"s\":\"t\",\"args\":{\"addr\":\"" FMT_PADDR "\"}",
+          e->name, (paddr_t)e->arg);
+      break;
+    case TL_GUEST_INTR:
+      fprintf(tl_fp, ",\"cat\":\"intr\",\"name\":\"%s\",\"s\":\"t\",\"args\":{\"cause\":\"" FMT_WORD "\"}",
+          e->name, (word_t)e->arg);
+      break;
+    case TL_HOST:
+      fprintf(tl_fp, ",\"cat\":\"host\",\"name\":\"%s\",\"dur\":%" PRIu64, e->name, e->dur);
+      break;
+  }
+  fputc('}', tl_fp);
+}
+
+static void *writer_main(void *arg) {
+  pthread_mutex_lock(&queue_lock);
+  while (true) {
+    while (queue_head == NULL && !writer_exit) pthread_cond_wait(&queue_cond, &queue_lock);
+    TlBuf *b = queue_head;
+    if (b == NULL) break;
+    queue_head = b->next;
+    if (queue_head == NULL) queue_tail = NULL;
+    pthread_mutex_unlock(&queue_lock);
+    for (int i = 0; i < b->nr; i ++) write_event(&b->ev[i]);
+    free(b);
+    pthread_mutex_lock(&queue_lock);
+  }
+  pthread_mutex_unlock(&queue_lock);
+  return NULL;
+}
+
+void timeline_flush_thread() {
+  TlBuf *b = cur_buf;
+  if (b == NULL || b->nr == 0) return;
+  cur_buf = NULL;
+  b->next = NULL;
+  pthread_mutex_lock(&queue_lock);
+  if (queue_tail) queue_tail->next = b;
+  else queue_head = b;
+  queue_tail = b;
+  pthread_cond_signal(&queue_cond);
+  pthread_mutex_unlock(&queue_lock);
+}
+
+static void put_event(TlEvent ev) {
+  if (cur_buf == NULL) {
+    cur_buf = malloc(sizeof(TlBuf));
+    assert(cur_buf);
+    cur_buf->nr = 0;
+  }
+  ev.tid = MUXDEF(CONFIG_SMP, hart_id(), 0);
+  cur_buf->ev[cur_buf->nr ++] = ev;
+  if (cur_buf->nr == BUF_NR_EVENT) timeline_flush_thread();
+}
+
+void timeline_guest(int kind, char ph, const char *name, uint64_t arg) {
+  if (!timeline_on) return;
+  put_event((TlEvent) { .kind = kind, .ph = ph, .name = name, .ts = g_nr_guest_inst, .arg = arg });
+}
+
+void timeline_host(const char *name, uint64_t start, uint64_t dur) {
+  if (!timeline_on) return;
+  put_event((TlEvent) { .kind = TL_HOST, .ph = 'X', .name = name, .ts = start, .dur = dur });
+}
+
+void timeline_close() {
+  if (!timeline_on) return;
+  timeline_on = false;
+  timeline_flush_thread();
+  pthread_mutex_lock(&queue_lock);
+  writer_exit = true;
+  pthread_cond_signal(&queue_cond);
+  pthread_mutex_unlock(&queue_lock);
+  pthread_join(writer, NULL);
+  fputs("\n]}\n", tl_fp);
+  fclose(tl_fp);
+}
+
+void init_timeline(const char *file) {
+  if (file == NULL) return;
+  tl_fp = fopen(file, "w");
+  Assert(tl_fp, "Can not open '%s'", file);
+  fputs("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n"
+      "{\"ph\":\"M\",\"pid\":0,\"name\":\"process_name\",\"args\":{\"name\":\"guest (ts: instructions)\"}},\n"
+      "{\"ph\":\"M\",\"pid\":1,\"name\":\"process_name\",\"args\":{\"name\":\"host (ts: us)\"}}", tl_fp);
+  first_event = false;
+  int ret = pthread_create(&writer, NULL, writer_main, NULL);
+  Assert(ret == 0, "Can not create the timeline writer thread");
+  timeline_on = true;
+  atexit(timeline_close);
+  Log("Timeline is written to %s", file);
+}
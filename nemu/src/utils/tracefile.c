@@ -0,0 +1,59 @@
+/***************************************************************************************
+* Copyright (c) 2014-2024 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#include <cpu/itrace.h>
+#include <zlib.h>
+
+struct TraceFile {
+  FILE *fp;
+  uint8_t *comp;
+  uLong comp_size;
+};
+
+void trace_file_write_raw(TraceFile *tf, const void *buf, size_t len) {
+  fwrite(buf, len, 1, tf->fp);
+}
+
+void trace_file_write_u32(TraceFile *tf, uint32_t v) {
+  trace_file_write_raw(tf, &v, sizeof(v));
+}
+
+TraceFile *trace_file_open(const char *file, const char *magic, size_t max_raw_len) {
+  TraceFile *tf = malloc(sizeof(*tf));
+  assert(tf);
+  tf->fp = fopen(file, "wb");
+  Assert(tf->fp, "Can not open '%s'", file);
+  fwrite(magic, 8, 1, tf->fp);
+  trace_file_write_u32(tf, sizeof(word_t));
+  trace_file_write_u32(tf, 0);
+  tf->comp_size = compressBound(max_raw_len);
+  tf->comp = malloc(tf->comp_size);
+  assert(tf->comp);
+  return tf;
+}
+
+void trace_file_write_block(TraceFile *tf, const void *raw, uint32_t raw_len, uint32_t nr_rec) {
+  uLong comp_len = tf->comp_size;
+  int ret = compress2(tf->comp, &comp_len, raw, raw_len, Z_BEST_SPEED);
+  Assert(ret == Z_OK, "zlib fails to compress the trace, ret = %d", ret);
+  trace_file_write_u32(tf, nr_rec);
+  trace_file_write_u32(tf, raw_len);
+  trace_file_write_u32(tf, comp_len);
+  fwrite(tf->comp, comp_len, 1, tf->fp);
+}
+
+void trace_file_flush(TraceFile *tf) {
+  fflush(tf->fp);
+}
@@ -0,0 +1,245 @@
+/***************************************************************************************
+* Copyright (c) 2014-2024 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+// Merge the coverage files written by NEMU with --coverage, and convert
+// them to lcov with the line table of the guest ELF. The line table is
+// read by addr2line from binutils. See include/cpu/coverage.h for the
+// file format.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <elf.h>
+
+enum { COV_EXEC, COV_TAKEN, COV_NOT_TAKEN, NR_COV_MAP };
+
+typedef struct {
+  char magic[8];
+  uint32_t slot_shift, reserved;
+  uint64_t base, nr_slot;
+} CovHeader;
+
+static CovHeader hdr;
+static uint8_t *map[NR_COV_MAP] = {};
+static size_t map_len = 0;
+
+static bool test_bit(int m, uint64_t addr) {
+  uint64_t idx = (addr - hdr.base) >> hdr.slot_shift;
+  return idx < hdr.nr_slot && (map[m][idx >> 3] >> (idx & 7)) & 1;
+}
+
+static void load_cov(const char *file) {
+  FILE *fp = fopen(file, "rb");
+  if (fp == NULL) { perror(file); exit(1); }
+  CovHeader h;
+  if (fread(&h, sizeof(h), 1, fp) != 1 || memcmp(h.magic, "NEMUCOV1", 8) != 0) {
+    fprintf(stderr, "%s is not a NEMU coverage file\n", file);
+    exit(1);
+  }
+  if (map_len == 0) {
+    hdr = h;
+    map_len = (h.nr_slot + 7) / 8;
+    for (int m = 0; m < NR_COV_MAP; m ++) map[m] = calloc(map_len, 1);
+  } else if (memcmp(&h, &hdr, sizeof(h)) != 0) {
+    fprintf(stderr, "%s has a different memory layout\n", file);
+    exit(1);
+  }
+  uint8_t *buf = malloc(map_len);
+  for (int m = 0; m < NR_COV_MAP; m ++) {
+    if (fread(buf, map_len, 1, fp) != 1) {
+      fprintf(stderr, "%s is truncated\n", file);
+      exit(1);
+    }
+    for (size_t i = 0; i < map_len; i ++) map[m][i] |= buf[i];
+  }
+  free(buf);
+  fclose(fp);
+}
+
+static void save_cov(const char *file) {
+  FILE *fp = fopen(file, "wb");
+  if (fp == NULL) { perror(file); exit(1); }
+  fwrite(&hdr, sizeof(hdr), 1, fp);
+  for (int m = 0; m < NR_COV_MAP; m ++) fwrite(map[m], map_len, 1, fp);
+  fclose(fp);
+}
+
+// an instruction slot in an executable section of the ELF
+typedef struct {
+  uint64_t addr;
+  bool is_branch;
+  char *file;
+  int line;
+} Slot;
+
+static Slot *slots = NULL;
+static int nr_slot = 0;
+
+static void add_section(const uint8_t *code, uint64_t addr, uint64_t size, bool riscv) {
+  uint64_t step = 1ull << hdr.slot_shift;
+  slots = realloc(slots, sizeof(Slot) * (nr_slot + size / step + 1));
+  for (uint64_t off = 0; off + step <= size; off += step) {
+    uint32_t inst = 0;
+    memcpy(&inst, code + off, (size - off < 4 ? size - off : 4));
+    slots[nr_slot ++] = (Slot) { .addr = addr + off, .is_branch = riscv && (inst & 0x7f) == 0x63 };
+  }
+}
+
+#define LOAD_SECTIONS(Ehdr, Shdr) do { \
+  Ehdr *eh = (Ehdr *)buf; \
+  Shdr *sh = (Shdr *)(buf + eh->e_shoff); \
+  bool riscv = (eh->e_machine == EM_RISCV); \
+  for (int i = 0; i < eh->e_shnum; i ++) { \
+    if (sh[i].sh_type != SHT_PROGBITS || !(sh[i].sh_flags & SHF_EXECINSTR)) continue; \
+    add_section(buf + sh[i].sh_offset, sh[i].sh_addr, sh[i].sh_size, riscv); \
+  } \
+} while (0)
+
+static void load_elf(const char *file) {
+  FILE *fp = fopen(file, "rb");
+  if (fp == NULL) { perror(file); exit(1); }
+  fseek(fp, 0, SEEK_END);
+  long size = ftell(fp);
+  fseek(fp, 0, SEEK_SET);
+  uint8_t *buf = malloc(size);
+  if (fread(buf, size, 1, fp) != 1 || size < EI_NIDENT || memcmp(buf, ELFMAG, SELFMAG) != 0) {
+    fprintf(stderr, "%s is not an ELF file\n", file);
+    exit(1);
+  }
+  fclose(fp);
+  if (buf[EI_CLASS] == ELFCLASS64) LOAD_SECTIONS(Elf64_Ehdr, Elf64_Shdr);
+  else LOAD_SECTIONS(Elf32_Ehdr, Elf32_Shdr);
+  free(buf);
+}
+
+// map every slot to its source line with one run of addr2line
+static void resolve_lines(const char *elf) {
+  char tmp[] = "/tmp/nemu-cov-XXXXXX";
+  int fd = mkstemp(tmp);
+  FILE *fp = fdopen(fd, "w");
+  for (int i = 0; i < nr_slot; i ++) fprintf(fp, "0x%lx\n", slots[i].addr);
+  fclose(fp);
+
+  char cmd[4096];
+  snprintf(cmd, sizeof(cmd), "addr2line -e '%s' < %s", elf, tmp);
+  FILE *p = popen(cmd, "r");
+  if (p == NULL) { perror("addr2line"); exit(1); }
+  char line[4096];
+  for (int i = 0; i < nr_slot && fgets(line, sizeof(line), p) != NULL; i ++) {
+    // "file:line" or "file:line (discriminator n)"; "??:0" if unknown
+    char *colon = strrchr(line, ':');
+    if (colon == NULL || line[0] == '?') continue;
+    *colon = '\0';
+    slots[i].file = strdup(line);
+    slots[i].line = atoi(colon + 1);
+  }
+  pclose(p);
+  unlink(tmp);
+}
+
+static int slot_cmp(const void *a, const void *b) {
+  const Slot *x = a, *y = b;
+  int r = strcmp(x->file, y->file);
+  if (r != 0) return r;
+  if (x->line != y->line) return x->line - y->line;
+  return (x->addr > y->addr) - (x->addr < y->addr);
+}
+
+static void write_lcov(FILE *fp) {
+  // drop the slots without line information
+  int n = 0;
+  for (int i = 0; i < nr_slot; i ++) {
+    if (slots[i].file != NULL && slots[i].line > 0) slots[n ++] = slots[i];
+  }
+  qsort(slots, n, sizeof(Slot), slot_cmp);
+
+  fprintf(fp, "TN:\n");
+  for (int i = 0; i < n; ) {
+    const char *file = slots[i].file;
+    int lf = 0, lh = 0, brf = 0, brh = 0;
+    fprintf(fp, "SF:%s\n", file);
+    while (i < n && strcmp(slots[i].file, file) == 0) {
+      // all slots of a line
+      int line = slots[i].line, j;
+      bool hit = false;
+      for (j = i; j < n && slots[j].line == line && strcmp(slots[j].file, file) == 0; j ++) {
+        hit |= test_bit(COV_EXEC, slots[j].addr);
+      }
+      for (int k = i, blk = 0; k < j; k ++) {
+        if (!slots[k].is_branch) continue;
+        bool exec = test_bit(COV_EXEC, slots[k].addr);
+        for (int br = 0; br < 2; br ++) {
+          bool taken = test_bit(br == 0 ? COV_TAKEN : COV_NOT_TAKEN, slots[k].addr);
+          if (exec) fprintf(fp, "BRDA:%d,%d,%d,%d\n", line, blk, br, taken);
+          else fprintf(fp, "BRDA:%d,%d,%d,-\n", line, blk, br);
+          brf ++;
+          brh += taken;
+        }
+        blk ++;
+      }
+      fprintf(fp, "DA:%d,%d\n", line, hit);
+      lf ++;
+      lh += hit;
+      i = j;
+    }
+    fprintf(fp, "LF:%d\nLH:%d\nBRF:%d\nBRH:%d\nend_of_record\n", lf, lh, brf, brh);
+  }
+}
+
+static void usage(const char *name) {
+  printf("Usage: %s [OPTION...] COVERAGE...\n\n", name);
+  printf("\t-o,--output=FILE        write the merged coverage to FILE\n");
+  printf("\t-e,--elf=FILE           the guest ELF with debug information\n");
+  printf("\t-l,--lcov=FILE          write lcov tracefile to FILE (default: stdout)\n");
+  printf("\nThe coverage files are ORed together. lcov is only written with --elf.\n");
+  exit(0);
+}
+
+int main(int argc, char *argv[]) {
+  const struct option table[] = {
+    {"output", required_argument, NULL, 'o'},
+    {"elf"   , required_argument, NULL, 'e'},
+    {"lcov"  , required_argument, NULL, 'l'},
+    {"help"  , no_argument      , NULL, 'h'},
+    {0       , 0                , NULL,  0 },
+  };
+  const char *out = NULL, *elf = NULL, *lcov = NULL;
+  int o;
+  while ( (o = getopt_long(argc, argv, "o:e:l:h", table, NULL)) != -1) {
+    switch (o) {
+      case 'o': out = optarg; break;
+      case 'e': elf = optarg; break;
+      case 'l': lcov = optarg; break;
+      default: usage(argv[0]);
+    }
+  }
+  if (optind == argc) usage(argv[0]);
+  for (int i = optind; i < argc; i ++) load_cov(argv[i]);
+  if (out != NULL) save_cov(out);
+
+  if (elf != NULL) {
+    load_elf(elf);
+    resolve_lines(elf);
+    FILE *fp = (lcov ? fopen(lcov, "w") : stdout);
+    if (fp == NULL) { perror(lcov); return 1; }
+    write_lcov(fp);
+    if (fp != stdout) fclose(fp);
+  }
+  return 0;
+}
@@ -0,0 +1,217 @@
+/***************************************************************************************
+* Copyright (c) 2014-2024 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+// Print the binary instruction trace written by NEMU with --itrace, or
+// the function call trace written with --ftrace as a call tree.
+// See include/cpu/itrace.h and include/cpu/ftrace.h for the file formats.
+// Only traces of riscv are supported, since the disassembler and the
+// register names below are the ones of riscv.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <getopt.h>
+#include <zlib.h>
+
+#define REC_RD  0x1
+#define REC_MEM 0x2
+
+static uint64_t first = 0, last = UINT64_MAX;    // range of record index
+static uint64_t pc_lo = 0, pc_hi = UINT64_MAX;   // range of pc
+static bool disasm = false;
+static int word_size = 4;
+
+// from src/isa/riscv32/disasm.c, which takes the register names from here
+void disassemble(char *str, int size, uint64_t pc, uint8_t *code, int nbyte);
+const char *regs[] = {
+  "$0", "ra", "sp", "gp", "tp", "t0", "t1", "t2",
+  "s0", "s1", "a0", "a1", "a2", "a3", "a4", "a5",
+  "a6", "a7", "s2", "s3", "s4", "s5", "s6", "s7",
+  "s8", "s9", "s10", "s11", "t3", "t4", "t5", "t6"
+};
+
+// function symbols stored in the header of a function call trace
+typedef struct {
+  uint64_t start, end;
+  char *name;
+} Sym;
+static Sym *syms = NULL;
+static uint32_t nr_sym = 0;
+static bool is_ftrace = false;
+
+static const char *sym_name(uint64_t addr) {
+  int lo = 0, hi = (int)nr_sym - 1, found = -1;
+  while (lo <= hi) {
+    int mid = (lo + hi) / 2;
+    if (syms[mid].start <= addr) { found = mid; lo = mid + 1; }
+    else hi = mid - 1;
+  }
+  return (found >= 0 && addr < syms[found].end ? syms[found].name : "???");
+}
+
+static bool read_syms(FILE *fp) {
+  if (fread(&nr_sym, sizeof(nr_sym), 1, fp) != 1) return false;
+  syms = calloc(nr_sym, sizeof(Sym));
+  for (uint32_t i = 0; i < nr_sym; i ++) {
+    uint64_t range[2];
+    uint32_t len;
+    if (fread(range, sizeof(range), 1, fp) != 1 || fread(&len, sizeof(len), 1, fp) != 1) return false;
+    syms[i] = (Sym) { .start = range[0], .end = range[1], .name = malloc(len + 1) };
+    if (len > 0 && fread(syms[i].name, len, 1, fp) != 1) return false;
+    syms[i].name[len] = '\0';
+  }
+  return true;
+}
+
+static uint64_t get_varint(const uint8_t **p) {
+  uint64_t v = 0;
+  int shift = 0;
+  uint8_t b;
+  do {
+    b = *(*p) ++;
+    v |= (uint64_t)(b & 0x7f) << shift;
+    shift += 7;
+  } while (b & 0x80);
+  return v;
+}
+
+static int64_t unzigzag(uint64_t v) {
+  return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+static void print_block(const uint8_t *p, uint32_t nr, uint64_t base) {
+  uint64_t mask = (word_size == 8 ? UINT64_MAX : UINT32_MAX);
+  uint64_t pc = 0, maddr = 0;
+  for (uint32_t i = 0; i < nr; i ++) {
+    uint8_t flags = *p ++;
+    pc = (pc + unzigzag(get_varint(&p))) & mask;
+    uint32_t inst;
+    memcpy(&inst, p, 4);
+    p += 4;
+    uint64_t rd = (flags & REC_RD ? get_varint(&p) : 0);
+    if (flags & REC_MEM) maddr = (maddr + unzigzag(get_varint(&p))) & mask;
+
+    uint64_t idx = base + i;
+    if (idx < first || idx > last || pc < pc_lo || pc > pc_hi) continue;
+    printf("%10lu  0x%0*lx: %08x", idx, word_size * 2, pc, inst);
+    if (disasm) {
+      char buf[128];
+      disassemble(buf, sizeof(buf), pc, (uint8_t *)&inst, 4);
+      printf("  %-32s", buf);
+    }
+    if (flags & REC_RD) printf("  rd = 0x%0*lx", word_size * 2, rd);
+    if (flags & REC_MEM) printf("  mem = 0x%0*lx", word_size * 2, maddr);
+    putchar('\n');
+  }
+}
+
+static void print_ftrace_block(const uint8_t *p, uint32_t nr, uint64_t base) {
+  static int depth = 0;
+  static uint64_t ninst = 0;
+  uint64_t mask = (word_size == 8 ? UINT64_MAX : UINT32_MAX);
+  uint64_t pc = 0;
+  for (uint32_t i = 0; i < nr; i ++) {
+    uint8_t kind = *p ++;
+    pc = (pc + unzigzag(get_varint(&p))) & mask;
+    uint64_t target = (pc + unzigzag(get_varint(&p))) & mask;
+    ninst += get_varint(&p);
+
+    uint64_t idx = base + i;
+    bool show = !(idx < first || idx > last || pc < pc_lo || pc > pc_hi);
+    if (kind == 1 && depth > 0) depth --;
+    if (show) {
+      printf("%10lu  %12lu  0x%0*lx: %*s", idx, ninst, word_size * 2, pc, depth * 2, "");
+      if (kind == 0) printf("call [%s@0x%0*lx]\n", sym_name(target), word_size * 2, target);
+      else printf("ret  [%s]\n", sym_name(pc));
+    }
+    if (kind == 0) depth ++;
+  }
+}
+
+static void usage(const char *name) {
+  printf("Usage: %s [OPTION...] TRACE\n\n", name);
+  printf("\t-r,--range=FIRST:LAST   only print records with index in [FIRST, LAST]\n");
+  printf("\t-p,--pc=LO:HI           only print records with pc in [LO, HI]\n");
+  printf("\t-d,--disasm             disassemble the instructions\n");
+  printf("\nRecords of a function call trace are printed as an indented call tree\n");
+  printf("with the instruction count when each call or return happened.\n");
+  exit(0);
+}
+
+int main(int argc, char *argv[]) {
+  const struct option table[] = {
+    {"range" , required_argument, NULL, 'r'},
+    {"pc"    , required_argument, NULL, 'p'},
+    {"disasm", no_argument      , NULL, 'd'},
+    {"help"  , no_argument      , NULL, 'h'},
+    {0       , 0                , NULL,  0 },
+  };
+  int o;
+  while ( (o = getopt_long(argc, argv, "r:p:dh", table, NULL)) != -1) {
+    switch (o) {
+      case 'r': sscanf(optarg, "%lu:%lu", &first, &last); break;
+      case 'p': sscanf(optarg, "%lx:%lx", &pc_lo, &pc_hi); break;
+      case 'd': disasm = true; break;
+      default: usage(argv[0]);
+    }
+  }
+  if (optind != argc - 1) usage(argv[0]);
+
+  FILE *fp = fopen(argv[optind], "rb");
+  if (fp == NULL) { perror(argv[optind]); return 1; }
+  char magic[8];
+  uint32_t hdr[2];
+  bool ok = (fread(magic, 8, 1, fp) == 1);
+  is_ftrace = ok && memcmp(magic, "NEMUFTR1", 8) == 0;
+  ok = ok && (is_ftrace || memcmp(magic, "NEMUITR1", 8) == 0);
+  ok = ok && fread(hdr, sizeof(hdr), 1, fp) == 1;
+  if (ok && is_ftrace) ok = read_syms(fp);
+  if (!ok) {
+    fprintf(stderr, "%s is not a NEMU trace\n", argv[optind]);
+    return 1;
+  }
+  word_size = hdr[0];
+
+  uint8_t *raw = NULL, *comp = NULL;
+  uint32_t bhdr[3];
+  uint64_t base = 0;
+  while (base <= last && fread(bhdr, sizeof(bhdr), 1, fp) == 1) {
+    uint32_t nr = bhdr[0], raw_len = bhdr[1], comp_len = bhdr[2];
+    if (!is_ftrace && base + nr <= first) {
+      // skip the whole block without decompressing it, but the call depth
+      // in a function call trace depends on all earlier blocks
+      fseek(fp, comp_len, SEEK_CUR);
+      base += nr;
+      continue;
+    }
+    raw = realloc(raw, raw_len);
+    comp = realloc(comp, comp_len);
+    if (fread(comp, comp_len, 1, fp) != 1) break;
+    uLongf len = raw_len;
+    if (uncompress(raw, &len, comp, comp_len) != Z_OK || len != raw_len) {
+      fprintf(stderr, "corrupted block at record %lu\n", base);
+      return 1;
+    }
+    if (is_ftrace) print_ftrace_block(raw, nr, base);
+    else print_block(raw, nr, base);
+    base += nr;
+  }
+  free(raw);
+  free(comp);
+  fclose(fp);
+  return 0;
+}
@@ -0,0 +1,100 @@
+/***************************************************************************************
+* Copyright (c) 2014-2024 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+// Print the working set file written by NEMU with --wss as CSV, one row
+// for each interval and stream, or with -H the page heat map, one row for
+// each page touched in an interval. See include/memory/wss.h for the file
+// format.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <getopt.h>
+
+typedef struct {
+  char magic[8];
+  uint32_t line_shift, page_shift, nr_bucket, reserved;
+  uint64_t base;
+} WssHeader;
+
+static const char *stream_name[] = { "inst", "data" };
+
+static void usage(const char *prog) {
+  printf("Usage: %s [-H] FILE\n\n", prog);
+  printf("\t-H,--heat     print the accesses to each page instead of the working sets\n");
+  exit(0);
+}
+
+int main(int argc, char *argv[]) {
+  const struct option table[] = {
+    {"heat", no_argument, NULL, 'H'},
+    {"help", no_argument, NULL, 'h'},
+    {0     , 0          , NULL,  0 },
+  };
+  bool heat = false;
+  int o;
+  while ( (o = getopt_long(argc, argv, "Hh", table, NULL)) != -1) {
+    switch (o) {
+      case 'H': heat = true; break;
+      default: usage(argv[0]);
+    }
+  }
+  if (optind != argc - 1) usage(argv[0]);
+
+  FILE *fp = fopen(argv[optind], "rb");
+  if (fp == NULL) { perror(argv[optind]); return 1; }
+  WssHeader h;
+  if (fread(&h, sizeof(h), 1, fp) != 1 || memcmp(h.magic, "NEMUWSS1", 8) != 0) {
+    fprintf(stderr, "%s is not a NEMU working set file\n", argv[optind]);
+    return 1;
+  }
+
+  if (heat) printf("interval,first_inst,page_addr,accesses\n");
+  else {
+    printf("interval,first_inst,nr_inst,stream,accesses,lines,pages,cold");
+    for (uint32_t b = 1; b < h.nr_bucket; b ++) printf(",rd_%lu", b == 1 ? 0 : 1ul << (b - 2));
+    printf("\n");
+  }
+
+  uint64_t *hist = malloc(sizeof(uint64_t) * h.nr_bucket);
+  uint32_t *page = NULL, *count = NULL;
+  uint64_t head[2];
+  for (int i = 0; fread(head, sizeof(head), 1, fp) == 1; i ++) {
+    for (int s = 0; s < 2; s ++) {
+      uint64_t c[3];
+      if (fread(c, sizeof(c), 1, fp) != 1 || fread(hist, sizeof(uint64_t), h.nr_bucket, fp) != h.nr_bucket) goto bad;
+      if (heat) continue;
+      printf("%d,%lu,%lu,%s,%lu,%lu,%lu", i, head[0], head[1], stream_name[s], c[0], c[1], c[2]);
+      for (uint32_t b = 0; b < h.nr_bucket; b ++) printf(",%lu", hist[b]);
+      printf("\n");
+    }
+    uint32_t nr;
+    if (fread(&nr, sizeof(nr), 1, fp) != 1) goto bad;
+    page = realloc(page, sizeof(uint32_t) * (nr + 1));
+    count = realloc(count, sizeof(uint32_t) * (nr + 1));
+    if (fread(page, sizeof(uint32_t), nr, fp) != nr || fread(count, sizeof(uint32_t), nr, fp) != nr) goto bad;
+    for (uint32_t k = 0; heat && k < nr; k ++) {
+      printf("%d,%lu,0x%lx,%u\n", i, head[0], h.base + ((uint64_t)page[k] << h.page_shift), count[k]);
+    }
+  }
+  fclose(fp);
+  return 0;
+
+bad:
+  fprintf(stderr, "truncated interval\n");
+  return 1;
+}
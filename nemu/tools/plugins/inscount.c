@@ -0,0 +1,72 @@
+/***************************************************************************************
+* Copyright (c) 2014-2024 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+// An example plugin counting executed instructions and data accesses.
+// With the argument "inst", every instruction is also counted one by one,
+// and with "async", the events are also counted on the analysis thread.
+
+#include <nemu-plugin.h>
+#include <stdio.h>
+#include <string.h>
+
+static struct {
+  uint64_t block_inst, inst, load, store, mmio, trap;
+  uint64_t async[NEMU_EV_BRANCH + 1];
+} cnt;
+
+static void block_exec(void *udata, uint64_t pc, uint64_t nr_inst) { cnt.block_inst += nr_inst; }
+static void inst_exec(void *udata, uint64_t pc, uint32_t inst) { cnt.inst ++; }
+
+static void mem_access(void *udata, uint64_t vaddr, int len, bool is_write, uint64_t data) {
+  if (is_write) cnt.store ++;
+  else cnt.load ++;
+}
+
+static void mmio_access(void *udata, const char *dev, uint64_t paddr, int len, bool is_write, uint64_t data) {
+  cnt.mmio ++;
+}
+
+static void trap(void *udata, uint64_t epc, uint64_t cause) { cnt.trap ++; }
+
+static void async_events(void *udata, const NemuPluginEvent *ev, int nr) {
+  for (int i = 0; i < nr; i ++) cnt.async[ev[i].kind] ++;
+}
+
+static void plugin_exit(void *udata) {
+  printf("inscount: %lu instructions (%lu counted one by one), %lu loads, %lu stores, "
+      "%lu mmio accesses, %lu traps\n",
+      cnt.block_inst, cnt.inst, cnt.load, cnt.store, cnt.mmio, cnt.trap);
+  printf("inscount: async %lu instructions, %lu loads, %lu stores, %lu branches\n",
+      cnt.async[NEMU_EV_INST], cnt.async[NEMU_EV_LOAD], cnt.async[NEMU_EV_STORE], cnt.async[NEMU_EV_BRANCH]);
+}
+
+__attribute__((visibility("default")))
+int nemu_plugin_install(const char *args, NemuPluginCallbacks *cb) {
+  if (cb->version != NEMU_PLUGIN_VERSION) return -1;
+  cb->block_exec = block_exec;
+  if (strcmp(args, "inst") == 0) cb->inst_exec = inst_exec;
+  if (strcmp(args, "async") == 0) {
+    if (!NEMU_PLUGIN_HAS(cb, async_drop)) {
+      printf("inscount: async events are not supported by this NEMU\n");
+      return -1;
+    }
+    cb->async_events = async_events;
+  }
+  cb->mem_access = mem_access;
+  cb->mmio_access = mmio_access;
+  cb->trap = trap;
+  cb->exit = plugin_exit;
+  return 0;
+}